@@ -1,102 +1,184 @@
 #include <iostream>
 #include <vector>
 #include <string>
-#include <queue>
-
-std::vector<std::vector<int>> read_map() {
+#include <algorithm>
+#include <thread>
+#include <cstdint>
+#include <cstring>
+
+// Map stored as one flat byte array, with a border of 9s around it so
+// that every real cell has four neighbours and no bounds checks are needed
+struct HeightMap {
+    int n, m;           // real rows, columns
+    int stride;         // padded row length
+    std::vector<uint8_t> cells;
+
+    uint8_t at(int i, int j) const { return cells[idx(i, j)]; }
+    int idx(int i, int j) const { return (i+1)*stride + (j+1); }
+};
+
+HeightMap read_map() {
     std::vector<std::string> lines;
     std::string line;
-    int nlines = 0;
     while (std::cin >> line) {
         lines.push_back(line);
-        nlines++;
     }
 
-    std::vector<std::vector<int>> map(nlines);
-    for (int i = 0; i < nlines; i++ ) {
-        for (int j = 0; j < lines[i].length(); j++) {
-            map[i].push_back(lines[i][j] - '0');
+    HeightMap map;
+    map.n = lines.size();
+    map.m = map.n > 0 ? lines[0].length() : 0;
+    map.stride = map.m + 2;
+    map.cells.assign((map.n + 2) * map.stride, 9);
+
+    for (int i = 0; i < map.n; i++) {
+        for (int j = 0; j < map.m; j++) {
+            map.cells[map.idx(i, j)] = lines[i][j] - '0';
         }
     }
 
     return map;
 }
 
-std::vector<std::pair<int,int>> local_minima(std::vector<std::vector<int>> &map) {
-    std::vector<std::pair<int,int>> local_mins;
+// split [0, n) into roughly equal bands, one per thread
+std::vector<std::pair<int,int>> row_bands(int n) {
+    int nthreads = std::max(1u, std::thread::hardware_concurrency());
+    nthreads = std::max(1, std::min(nthreads, n));
+
+    std::vector<std::pair<int,int>> bands;
+    for (int t = 0; t < nthreads; t++) {
+        bands.push_back(std::make_pair(n * t / nthreads, n * (t+1) / nthreads));
+    }
+    return bands;
+}
 
-    std::vector<int> neighbour_heights(4, 0);
-    for (int i = 0; i < map.size(); i++) {
-        for (int j = 0; j < map[i].size(); j++) {
-            int nneigh = 0;
-            if (i > 0)
-                neighbour_heights[nneigh++] = map[i - 1][j];
-            if (i < map.size() - 1) 
-                neighbour_heights[nneigh++] = map[i + 1][j];
-            if (j > 0) 
-                neighbour_heights[nneigh++] = map[i][j-1];
-            if (j < map[i].size() - 1)
-                neighbour_heights[nneigh++] = map[i][j+1];
-
-            if (map[i][j] < *std::min_element(neighbour_heights.begin(), neighbour_heights.begin() + nneigh)) {
-                local_mins.push_back(std::make_pair(i, j));
+template <typename F>
+void for_each_band(const std::vector<std::pair<int,int>>& bands, F f) {
+    std::vector<std::thread> threads;
+    for (int t = 0; t < bands.size(); t++) {
+        threads.emplace_back(f, t, bands[t].first, bands[t].second);
+    }
+    for (auto& th : threads) {
+        th.join();
+    }
+}
+
+typedef uint8_t ByteVec __attribute__((vector_size(32)));
+const int vec_width = sizeof(ByteVec);
+
+// one row of minima: compare 32 cells at a time against the rows above and below
+// and the row shifted left and right; the padding means those loads never leave the map
+void row_minima(const uint8_t* row, const int stride, const int m, uint8_t* is_min) {
+    int j = 0;
+    for (; j + vec_width <= m; j += vec_width) {
+        ByteVec c, up, down, left, right;
+        std::memcpy(&c, row + j, vec_width);
+        std::memcpy(&up, row + j - stride, vec_width);
+        std::memcpy(&down, row + j + stride, vec_width);
+        std::memcpy(&left, row + j - 1, vec_width);
+        std::memcpy(&right, row + j + 1, vec_width);
+
+        ByteVec mask = (c < up) & (c < down) & (c < left) & (c < right);
+        std::memcpy(is_min + j, &mask, vec_width);
+    }
+    for (; j < m; j++) {
+        const uint8_t c = row[j];
+        is_min[j] = (c < row[j-stride] && c < row[j+stride] && c < row[j-1] && c < row[j+1]) ? 0xff : 0;
+    }
+}
+
+std::vector<std::pair<int,int>> local_minima(const HeightMap& map) {
+    auto bands = row_bands(map.n);
+    std::vector<std::vector<std::pair<int,int>>> band_mins(bands.size());
+
+    for_each_band(bands, [&map, &band_mins](int t, int begin, int end) {
+        std::vector<uint8_t> is_min(map.m);
+        for (int i = begin; i < end; i++) {
+            row_minima(&map.cells[map.idx(i, 0)], map.stride, map.m, is_min.data());
+            for (int j = 0; j < map.m; j++) {
+                if (is_min[j])
+                    band_mins[t].push_back(std::make_pair(i, j));
             }
         }
-    }
+    });
 
+    std::vector<std::pair<int,int>> local_mins;
+    for (const auto& mins : band_mins) {
+        local_mins.insert(local_mins.end(), mins.begin(), mins.end());
+    }
     return local_mins;
 }
 
-std::vector<int> floodfill_basins(const std::vector<std::vector<int>>& map, const std::vector<std::pair<int,int>>& local_mins) {
-    std::vector<int> basin_sizes;
+int find_root(std::vector<int>& parent, int x) {
+    while (parent[x] != x) {
+        parent[x] = parent[parent[x]];
+        x = parent[x];
+    }
+    return x;
+}
 
-    const int n = map.size();
-    const int m = map[0].size();
-    char basin_ids[n][m];
+void join(std::vector<int>& parent, int a, int b) {
+    a = find_root(parent, a);
+    b = find_root(parent, b);
+    if (a == b)
+        return;
+    // keep the smaller index as root, so roots stay inside the band that owns them
+    if (a < b)
+        parent[b] = a;
+    else
+        parent[a] = b;
+}
 
-    for (int i=0; i<n; i++) {
-        for (int j=0; j<m; j++) {
-            if (map[i][j] == 9)
-                basin_ids[i][j] = ' ';
-            else 
-                basin_ids[i][j] = '.';
+// Basins are the connected regions of non-9 cells holding a low point.
+// Each band of rows is labelled independently with union-find, then labels
+// are merged across the seams between bands.
+std::vector<int> floodfill_basins(const HeightMap& map, const std::vector<std::pair<int,int>>& local_mins) {
+    const int ncells = map.cells.size();
+    std::vector<int> parent(ncells);
+    for (int c = 0; c < ncells; c++)
+        parent[c] = c;
+
+    auto bands = row_bands(map.n);
+
+    for_each_band(bands, [&map, &parent](int /*t*/, int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            for (int j = 0; j < map.m; j++) {
+                const int c = map.idx(i, j);
+                if (map.cells[c] == 9)
+                    continue;
+                if (map.cells[c-1] != 9)
+                    join(parent, c, c-1);
+                if (i > begin && map.cells[c-map.stride] != 9)
+                    join(parent, c, c-map.stride);
+            }
+        }
+    });
+
+    // stitch the seams
+    for (int t = 1; t < bands.size(); t++) {
+        const int i = bands[t].first;
+        for (int j = 0; j < map.m; j++) {
+            const int c = map.idx(i, j);
+            if (map.cells[c] != 9 && map.cells[c-map.stride] != 9)
+                join(parent, c, c-map.stride);
         }
     }
 
-    const int nminima = local_mins.size();
-
-    for (int min_id = 0, basin_id=0; min_id < nminima; min_id++) {
-        int i = local_mins[min_id].first;
-        int j = local_mins[min_id].second;
+    std::vector<int> sizes(ncells, 0);
+    for (int i = 0; i < map.n; i++) {
+        for (int j = 0; j < map.m; j++) {
+            const int c = map.idx(i, j);
+            if (map.cells[c] != 9)
+                sizes[find_root(parent, c)]++;
+        }
+    }
 
-        if (basin_ids[i][j] != '.') // already subsumed by another basin
+    std::vector<int> basin_sizes;
+    for (const auto& min: local_mins) {
+        const int root = find_root(parent, map.idx(min.first, min.second));
+        if (sizes[root] == 0) // already subsumed by another basin
             continue;
-
-        int basin_size = 0;
-
-        std::queue<std::pair<int,int>> q;
-        q.push(local_mins[min_id]);
-        while (!q.empty()) {
-            auto coords = q.front(); q.pop();
-            int i = coords.first;
-            int j = coords.second;
-
-            if (basin_ids[i][j] != '.')
-                continue;
-
-            basin_ids[i][j] = (basin_id % 26) + 'a';
-            basin_size++;
-            if (i > 0)
-                q.push(std::make_pair(i-1, j));
-            if (i < n-1)
-                q.push(std::make_pair(i+1, j));
-            if (j < m-1)
-                q.push(std::make_pair(i, j+1));
-            if (j > 0)
-                q.push(std::make_pair(i, j-1));
-        }
-        basin_sizes.push_back(basin_size);
-        basin_id++;
+        basin_sizes.push_back(sizes[root]);
+        sizes[root] = 0;
     }
 
     return basin_sizes;
@@ -109,7 +191,7 @@ int main() {
     std::cout << "Part 1:" << std::endl;
     int risk_level_sum = 0;
     for (const auto &min: minima) {
-        risk_level_sum += map[min.first][min.second] + 1;
+        risk_level_sum += map.at(min.first, min.second) + 1;
     }
     std::cout << "     " << risk_level_sum << std::endl;
 
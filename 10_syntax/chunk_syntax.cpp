@@ -1,75 +1,318 @@
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <vector>
-#include <stack>
-#include <map>
-#include <set>
-    
-const std::map<char,char> closes = {{')','('}, {']','['}, {'}','{'}, {'>','<'}};
-const std::map<char,int> invalid_points = {{')',3}, {']',57}, {'}',1197}, {'>',25137}};
-const std::map<char,int> missing_points = {{')',1}, {']',2}, {'}',3}, {'>',4}};
-
-int main() {
-    std::vector<std::string> v;
-    std::string input;
-    while (std::getline(std::cin, input)) {
-        v.push_back(input);
+#include <array>
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+#include <queue>
+#include <functional>
+
+// Every byte is classified once through a 256-entry table: the low bits
+// hold which kind of bracket it is, the high bits whether it opens or closes
+const uint8_t OPEN = 0x10;
+const uint8_t CLOSE = 0x20;
+const uint8_t KIND = 0x0f;
+
+std::array<uint8_t, 256> make_char_classes() {
+    std::array<uint8_t, 256> classes{};
+    const std::string openers = "([{<", closers = ")]}>";
+    for (int kind = 0; kind < 4; kind++) {
+        classes[(uint8_t)openers[kind]] = OPEN | kind;
+        classes[(uint8_t)closers[kind]] = CLOSE | kind;
+    }
+    return classes;
+}
+
+const std::array<uint8_t, 256> char_classes = make_char_classes();
+const std::array<int, 4> invalid_points = {3, 57, 1197, 25137};
+const std::array<int, 4> missing_points = {1, 2, 3, 4};
+
+// Contiguous stack of bracket kinds; starts with a fixed capacity and only
+// reallocates if a line nests deeper than that
+class ChunkStack {
+    public:
+        ChunkStack(size_t capacity=256) : data(capacity), top(0) {};
+        void clear() { top = 0; };
+        bool empty() const { return top == 0; };
+        size_t size() const { return top; };
+        void push(uint8_t kind) {
+            if (top == data.size())
+                data.resize(2*data.size());
+            data[top++] = kind;
+        };
+        uint8_t pop() { return data[--top]; };
+    private:
+        std::vector<uint8_t> data;
+        size_t top;
+};
+
+enum struct LineStatus {
+    COMPLETE,
+    INCOMPLETE,
+    CORRUPT
+};
+
+// score is the syntax error score for corrupt lines,
+// the completion score for incomplete lines
+struct LineResult {
+    LineStatus status;
+    long score;
+};
+
+LineResult validate_line(std::string_view line) {
+    thread_local ChunkStack s;
+    s.clear();
+
+    for (const char c : line) {
+        const uint8_t cls = char_classes[(uint8_t)c];
+        const uint8_t kind = cls & KIND;
+        if (cls & OPEN) {
+            s.push(kind);
+        } else if (cls & CLOSE) {
+            if (s.empty() || s.pop() != kind)
+                return {LineStatus::CORRUPT, invalid_points[kind]};
+        }
     }
 
-    std::map<char,char> opens;
-    for (auto c : closes) {
-        opens[c.second] = c.first;
+    if (s.empty())
+        return {LineStatus::COMPLETE, 0l};
+
+    long score = 0l;
+    while (!s.empty()) {
+        score *= 5;
+        score += missing_points[s.pop()];
     }
+    return {LineStatus::INCOMPLETE, score};
+}
+
+// For single lines too long to scan serially: each segment is reduced on its
+// own to the closers it could not match, followed by either the openers it
+// leaves dangling or its first mismatch. Those summaries merge associatively,
+// so segments can be combined pairwise in a parallel tree.
+struct Bracket {
+    size_t pos;
+    uint8_t kind;
+};
+
+struct SegmentSummary {
+    std::vector<Bracket> closers;
+    std::vector<uint8_t> openers;
+    bool corrupt = false;
+    Bracket mismatch;
+};
 
-    std::vector<std::vector<char>> incomplete_characters;
-    std::vector<char> bad_characters;
-
-    for (auto &str : v) {
-        std::stack<char> s;
-        bool valid = true;
-
-        for (auto &c : str) {
-            if (opens.find(c) != opens.end()) {
-                s.push(c);
-            } else if (closes.find(c) != closes.end()) {
-                if (s.empty() || s.top() != closes.at(c)) {
-                    bad_characters.push_back(c);
-                    valid = false;
-                    break;
-                } else {
-                    s.pop();
-                }
+SegmentSummary reduce_segment(std::string_view segment, const size_t offset) {
+    SegmentSummary summary;
+
+    for (size_t i = 0; i < segment.length(); i++) {
+        const uint8_t cls = char_classes[(uint8_t)segment[i]];
+        const uint8_t kind = cls & KIND;
+        if (cls & OPEN) {
+            summary.openers.push_back(kind);
+        } else if (cls & CLOSE) {
+            if (summary.openers.empty()) {
+                summary.closers.push_back({offset + i, kind});
+            } else if (summary.openers.back() != kind) {
+                summary.corrupt = true;
+                summary.mismatch = {offset + i, kind};
+                summary.openers.clear();
+                break;
+            } else {
+                summary.openers.pop_back();
             }
         }
+    }
 
-        if (valid && !s.empty()) {
-            std::vector<char> incomplete;
-            while (!s.empty()) {
-                incomplete.push_back(opens.at(s.top()));
-                s.pop();
-            }
-            incomplete_characters.push_back(incomplete);
+    return summary;
+}
+
+// fold the segment immediately to the right into left
+void merge_into(SegmentSummary& left, const SegmentSummary& right) {
+    if (left.corrupt)
+        return;
+
+    size_t i = 0;
+    for (; i < right.closers.size() && !left.openers.empty(); i++) {
+        if (left.openers.back() != right.closers[i].kind) {
+            left.corrupt = true;
+            left.mismatch = right.closers[i];
+            left.openers.clear();
+            return;
         }
+        left.openers.pop_back();
     }
+    left.closers.insert(left.closers.end(), right.closers.begin() + i, right.closers.end());
 
-    int score = 0;
-    for (const char c : bad_characters) 
-        score += invalid_points.at(c);
+    if (right.corrupt) {
+        left.corrupt = true;
+        left.mismatch = right.mismatch;
+        left.openers.clear();
+        return;
+    }
+    left.openers.insert(left.openers.end(), right.openers.begin(), right.openers.end());
+}
 
-    std::cout << "Part 1: " << std::endl;
-    std::cout << "      score = " << score << std::endl;
+void join_all(std::vector<std::thread>& threads) {
+    for (auto& t : threads)
+        t.join();
+    threads.clear();
+}
+
+SegmentSummary reduce_line(std::string_view line, int nsegments) {
+    nsegments = std::max(1, nsegments);
+    std::vector<SegmentSummary> parts(nsegments);
+    std::vector<std::thread> threads;
+
+    for (int t = 0; t < nsegments; t++) {
+        const size_t begin = line.length() * t / nsegments;
+        const size_t end = line.length() * (t+1) / nsegments;
+        threads.emplace_back([&parts, line, t, begin, end]() {
+            parts[t] = reduce_segment(line.substr(begin, end - begin), begin);
+        });
+    }
+    join_all(threads);
+
+    for (int width = 1; width < nsegments; width *= 2) {
+        for (int t = 0; t + width < nsegments; t += 2*width) {
+            threads.emplace_back([&parts, t, width]() {
+                merge_into(parts[t], parts[t+width]);
+                parts[t+width] = SegmentSummary();
+            });
+        }
+        join_all(threads);
+    }
+
+    return std::move(parts[0]);
+}
+
+// the serial scan stops at the first closer it cannot match:
+// an unmatched closer comes before any later mismatch
+bool first_corrupt(const SegmentSummary& summary, Bracket& bad) {
+    if (!summary.closers.empty()) {
+        bad = summary.closers[0];
+        return true;
+    }
+    if (summary.corrupt) {
+        bad = summary.mismatch;
+        return true;
+    }
+    return false;
+}
+
+LineResult line_result(const SegmentSummary& summary) {
+    Bracket bad;
+    if (first_corrupt(summary, bad))
+        return {LineStatus::CORRUPT, invalid_points[bad.kind]};
+
+    if (summary.openers.empty())
+        return {LineStatus::COMPLETE, 0l};
 
-    std::vector<long> scores;
-    for (const auto &incomplete : incomplete_characters) {
-        long score = 0l;
-        for (const char c : incomplete) {
-            score *= 5;
-            score += missing_points.at(c);
+    long score = 0l;
+    for (auto it = summary.openers.rbegin(); it != summary.openers.rend(); ++it) {
+        score *= 5;
+        score += missing_points[*it];
+    }
+    return {LineStatus::INCOMPLETE, score};
+}
+
+std::string completion_string(const SegmentSummary& summary) {
+    const std::string closers = ")]}>";
+    std::string completion;
+    completion.reserve(summary.openers.size());
+    for (auto it = summary.openers.rbegin(); it != summary.openers.rend(); ++it) {
+        completion += closers[*it];
+    }
+    return completion;
+}
+
+// Median of the completion scores seen so far, kept as two heaps so it is
+// available after every line; memory grows only with the incomplete lines.
+// Like sorting and taking scores[n/2], this is the upper median.
+class RunningMedian {
+    public:
+        void add(long score);
+        long median() const { return upper.top(); };
+        bool empty() const { return upper.empty(); };
+    private:
+        std::priority_queue<long> lower;
+        std::priority_queue<long, std::vector<long>, std::greater<long>> upper;
+};
+
+void RunningMedian::add(long score) {
+    if (upper.empty() || score >= upper.top())
+        upper.push(score);
+    else
+        lower.push(score);
+
+    if (upper.size() > lower.size() + 1) {
+        lower.push(upper.top());
+        upper.pop();
+    } else if (lower.size() > upper.size()) {
+        upper.push(lower.top());
+        lower.pop();
+    }
+}
+
+int main(int argc, char** argv) {
+    // --segmented [nsegments]: split each line into segments validated in parallel
+    // --running: report the scores so far after every line
+    bool segmented = false, running = false;
+    int nsegments = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--segmented") {
+            segmented = true;
+            if (i+1 < argc && isdigit(argv[i+1][0]))
+                nsegments = std::stoi(argv[++i]);
+        } else if (arg == "--running") {
+            running = true;
         }
-        scores.push_back(score);
     }
 
-    std::sort(scores.begin(), scores.end());
+    long score = 0;
+    RunningMedian scores;
+
+    // lines are validated as they are read, and never stored
+    std::string input;
+    for (size_t i = 0; std::getline(std::cin, input); i++) {
+        LineResult result;
+        if (segmented) {
+            const auto summary = reduce_line(input, nsegments);
+            result = line_result(summary);
+
+            Bracket bad;
+            std::cout << "line " << i+1 << ": ";
+            if (first_corrupt(summary, bad))
+                std::cout << "corrupt, found '" << input[bad.pos] << "' at position " << bad.pos << std::endl;
+            else if (result.status == LineStatus::INCOMPLETE)
+                std::cout << "incomplete, complete by adding " << completion_string(summary) << std::endl;
+            else
+                std::cout << "complete" << std::endl;
+        } else {
+            result = validate_line(input);
+        }
+
+        if (result.status == LineStatus::CORRUPT)
+            score += result.score;
+        else if (result.status == LineStatus::INCOMPLETE)
+            scores.add(result.score);
+
+        if (running) {
+            std::cout << "after line " << i+1 << ": part 1 score = " << score;
+            if (!scores.empty())
+                std::cout << ", part 2 score = " << scores.median();
+            std::cout << std::endl;
+        }
+    }
+
+    std::cout << "Part 1: " << std::endl;
+    std::cout << "      score = " << score << std::endl;
+
     std::cout << "Part 2: " << std::endl;
-    std::cout << "      score = " << scores[scores.size()/2] << std::endl;
-}
\ No newline at end of file
+    if (scores.empty())
+        std::cout << "      no incomplete lines" << std::endl;
+    else
+        std::cout << "      score = " << scores.median() << std::endl;
+}
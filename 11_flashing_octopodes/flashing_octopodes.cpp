@@ -3,49 +3,82 @@
 #include <sstream>
 #include <string>
 #include <vector>
+#include <array>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <stdexcept>
+#include <unordered_map>
 
+// The grid is stored flat with a one-cell border, so every octopus has eight
+// neighbours at fixed offsets and no bounds checks are needed
 class OctopusGrid {
     public:
         OctopusGrid(std::istream& input);
         std::string to_string() const;
-        int n_flashes() const;
+        long n_flashes() const;
+        long steps() const { return nsteps; };
         void evolve();
+        void fast_forward(const long target_step);
         bool all_flashed() const; // did all flash in the last round?
     private:
-        std::vector<std::vector<short int>> grid;
-        std::vector<std::pair<int, int>> neighbours(const std::pair<int, int>& pos) const;
-        int n, m;
-        int nflashes;
+        std::vector<uint8_t> grid;
+        std::array<int, 8> neighbour_offsets;
+        std::vector<int> flashers; // worklist, reused every step
+        int n, m, stride;
+        long nflashes;
+        long nsteps;
         bool allflashed;
+        static constexpr uint8_t BORDER = 0x80; // border cells never reach a flashing energy
+        void reset_border();
+        std::string packed_state() const;
 };
 
-OctopusGrid::OctopusGrid(std::istream& input) : nflashes(0), allflashed(false) {
+OctopusGrid::OctopusGrid(std::istream& input) : nflashes(0), nsteps(0), allflashed(false) {
     std::string line;
+    std::vector<std::string> lines;
 
     while (std::getline(input, line)) {
-        std::vector<short int> row;
-        for (char c : line) {
-            row.push_back(c - '0');
+        lines.push_back(line);
+    }
+
+    n = lines.size();
+    m = lines[0].length();
+    stride = m + 2;
+
+    grid.assign((n+2)*stride, BORDER);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < m; j++) {
+            grid[(i+1)*stride + j+1] = lines[i][j] - '0';
+        }
+    }
+
+    int k = 0;
+    for (int i=-1; i<=+1; i++) {
+        for (int j=-1; j<=+1; j++) {
+            if (i == 0 && j == 0) {
+                continue;
+            }
+            neighbour_offsets[k++] = i*stride + j;
         }
-        grid.push_back(row);
     }
 
-    n = grid.size();
-    m = grid[0].size();
+    flashers.reserve(n*m);
 }
 
 std::string OctopusGrid::to_string() const{
     std::stringstream output;
-    for (auto row : grid) {
-        for (auto c : row) {
-            output << c;
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < m; j++) {
+            output << (int)grid[(i+1)*stride + j+1];
         }
         output << std::endl;
     }
     return output.str();
 }
 
-int OctopusGrid::n_flashes() const {
+long OctopusGrid::n_flashes() const {
     return nflashes;
 }
 
@@ -53,61 +86,256 @@ bool OctopusGrid::all_flashed() const {
     return allflashed;
 }
 
-std::vector<std::pair<int, int>> OctopusGrid::neighbours(const std::pair<int, int>& pos) const {
-    std::vector<std::pair<int, int>> valid_neighbours;
+void OctopusGrid::reset_border() {
+    std::fill(grid.begin(), grid.begin() + stride, BORDER);
+    std::fill(grid.end() - stride, grid.end(), BORDER);
+    for (int i = 1; i <= n; i++) {
+        grid[i*stride] = BORDER;
+        grid[i*stride + m+1] = BORDER;
+    }
+}
 
-    for (int i=-1; i<=+1; i++) {
-        for (int j=-1; j<=+1; j++) {
-            if (i == 0 && j == 0) {
-                continue;
-            }
-            if (pos.first + i >= 0 && pos.first + i < n && pos.second + j >= 0 && pos.second + j < m) 
-                valid_neighbours.push_back(std::make_pair(pos.first + i, pos.second + j));
+void OctopusGrid::evolve() {
+    flashers.clear();
+
+    // everyone gets some energy; an octopus flashes as it reaches 10,
+    // so each one joins the worklist at most once per step
+    for (int i = 1; i <= n; i++) {
+        for (int c = i*stride + 1; c <= i*stride + m; c++) {
+            if (++grid[c] == 10)
+                flashers.push_back(c);
+        }
+    }
+
+    // let the flashing begin.
+    for (size_t k = 0; k < flashers.size(); k++) {
+        const int c = flashers[k];
+        for (const int offset : neighbour_offsets) {
+            if (++grid[c + offset] == 10)
+                flashers.push_back(c + offset);
         }
     }
 
-    return valid_neighbours;
+    for (const int flasher : flashers) {
+        grid[flasher] = 0;
+    }
+    reset_border();
+
+    nflashes += flashers.size();
+    allflashed = (flashers.size() == n*m);
+    nsteps++;
 }
 
-void OctopusGrid::evolve() {
-    // everyone gets some energy...
-    for (auto &row : grid) {
-        std::transform(row.begin(), row.end(), row.begin(), [](auto energy){return energy+1;});
+// energies packed two to a byte
+std::string OctopusGrid::packed_state() const {
+    std::string state((n*m + 1)/2, 0);
+    int k = 0;
+    for (int i = 1; i <= n; i++) {
+        for (int c = i*stride + 1; c <= i*stride + m; c++, k++) {
+            state[k/2] |= (k % 2) ? grid[c] << 4 : grid[c];
+        }
     }
+    return state;
+}
 
-    // let the flashing begin.
-    bool flashes_this_cycle;
-    std::vector<std::pair<int, int>> flashers;
-    do {
-        flashes_this_cycle = false;
-        
-        // find the flashers and increase their neighbour's energy
-        for (int i = 0; i < grid.size(); i++) {
-            for (int j = 0; j < grid[i].size(); j++) {
-                if (grid[i][j] > 9) {
-                    grid[i][j] = 0;
-                    auto coords = std::make_pair(i, j);
-                    flashers.push_back(coords);
-                    for (auto neighbour: neighbours(coords)) {
-                        grid[neighbour.first][neighbour.second]++;
-                    }
-                    flashes_this_cycle = true;
+// Evolve until target_step.  The grid has finitely many states, so once one
+// repeats the rest is a cycle: the flash count at the target follows
+// arithmetically and only the leftover part of a cycle is actually stepped.
+// all_flashed() depends only on the state (everyone is at 0), so it stays exact.
+void OctopusGrid::fast_forward(const long target_step) {
+    std::unordered_map<std::string, long> seen; // state -> step
+    std::vector<long> flashes_at;                // nflashes at each step since we started
+    const long start = nsteps;
+
+    seen[packed_state()] = nsteps;
+    flashes_at.push_back(nflashes);
+
+    while (nsteps < target_step) {
+        evolve();
+
+        const auto state = packed_state();
+        const auto it = seen.find(state);
+        if (it == seen.end()) {
+            seen[state] = nsteps;
+            flashes_at.push_back(nflashes);
+            continue;
+        }
+
+        const long first = it->second;
+        const long period = nsteps - first;
+        const long flashes_per_cycle = nflashes - flashes_at[first - start];
+        const long cycles = (target_step - first) / period;
+        const long offset = (target_step - first) % period;
+
+        for (long step = 0; step < offset; step++) {
+            evolve();
+        }
+        nflashes = flashes_at[first + offset - start] + cycles * flashes_per_cycle;
+        nsteps = target_step;
+        return;
+    }
+}
+
+typedef uint8_t ByteVec __attribute__((vector_size(32)));
+
+// Many independent 10x10 grids stepped together.  Energies are stored
+// cell-major with one byte lane per grid, so every operation on a cell
+// updates 32 grids at once; cascades track which lanes have flashed with masks.
+class OctopusBatch {
+    public:
+        OctopusBatch(std::istream& input);
+        int size() const { return ngrids; };
+        int steps() const { return nsteps; };
+        long n_flashes(int k) const { return nflashes[k]; };
+        int first_all_flash(int k) const { return first_allflash[k]; }; // -1 if not yet
+        void evolve();
+    private:
+        static const int N = 10;
+        static const int CELLS = N*N;
+        static const int LANES = sizeof(ByteVec);
+        int ngrids, nblocks, nsteps;
+        std::vector<ByteVec> energy; // [block*CELLS + cell]
+        std::vector<long> nflashes;
+        std::vector<int> first_allflash;
+        std::array<std::vector<int>, CELLS> neighbours;
+        void evolve_block(ByteVec* e, ByteVec& count);
+};
+
+// grids are 10 lines of 10 digits, separated by blank lines
+OctopusBatch::OctopusBatch(std::istream& input) : ngrids(0), nsteps(0) {
+    std::vector<std::string> cells;
+    std::string line, grid;
+
+    while (std::getline(input, line)) {
+        if (!line.empty())
+            grid += line;
+        if ((line.empty() || input.peek() == EOF) && !grid.empty()) {
+            if (grid.length() != CELLS)
+                throw std::runtime_error("batch grids must be 10x10");
+            cells.push_back(grid);
+            grid.clear();
+        }
+    }
+
+    ngrids = cells.size();
+    nblocks = (ngrids + LANES - 1) / LANES;
+    energy.assign(nblocks * CELLS, ByteVec{});
+    for (int k = 0; k < ngrids; k++) {
+        for (int c = 0; c < CELLS; c++) {
+            energy[(k / LANES) * CELLS + c][k % LANES] = cells[k][c] - '0';
+        }
+    }
+
+    nflashes.assign(ngrids, 0);
+    first_allflash.assign(ngrids, -1);
+
+    for (int i = 0; i < N; i++) {
+        for (int j = 0; j < N; j++) {
+            for (int di=-1; di<=+1; di++) {
+                for (int dj=-1; dj<=+1; dj++) {
+                    if ((di == 0 && dj == 0) || i+di < 0 || i+di >= N || j+dj < 0 || j+dj >= N)
+                        continue;
+                    neighbours[i*N + j].push_back((i+di)*N + j+dj);
                 }
             }
         }
-    } while (flashes_this_cycle);
+    }
+}
+
+bool any_lane(const ByteVec& v) {
+    uint64_t words[sizeof(ByteVec)/sizeof(uint64_t)];
+    std::memcpy(words, &v, sizeof(ByteVec));
+    uint64_t any = 0;
+    for (const auto w : words)
+        any |= w;
+    return any != 0;
+}
 
-    for (auto &flasher : flashers) {
-        grid[flasher.first][flasher.second] = 0;
+void OctopusBatch::evolve_block(ByteVec* e, ByteVec& count) {
+    ByteVec flashed[CELLS] = {};
+
+    for (int c = 0; c < CELLS; c++) {
+        e[c] += 1;
     }
 
-    nflashes += flashers.size();
-    allflashed = (flashers.size() == n*m);
+    // sweep until no lane has a new flasher; a lane's flash mask is all ones,
+    // so subtracting it gives that lane's neighbours one more unit of energy
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int c = 0; c < CELLS; c++) {
+            const ByteVec flashing = (ByteVec)(e[c] > 9) & ~flashed[c];
+            if (!any_lane(flashing))
+                continue;
+
+            changed = true;
+            flashed[c] |= flashing;
+            for (const int neighbour : neighbours[c]) {
+                e[neighbour] -= flashing;
+            }
+        }
+    }
+
+    count = ByteVec{};
+    for (int c = 0; c < CELLS; c++) {
+        e[c] &= ~flashed[c];
+        count += flashed[c] & 1;
+    }
+}
+
+void OctopusBatch::evolve() {
+    nsteps++;
+    for (int b = 0; b < nblocks; b++) {
+        ByteVec count;
+        evolve_block(&energy[b * CELLS], count);
+
+        for (int lane = 0; lane < LANES && b*LANES + lane < ngrids; lane++) {
+            const int k = b*LANES + lane;
+            nflashes[k] += count[lane];
+            if (count[lane] == CELLS && first_allflash[k] == -1)
+                first_allflash[k] = nsteps;
+        }
+    }
+}
+
+int run_batch(const char* filename, const int steps) {
+    std::ifstream input(filename);
+    OctopusBatch batch(input);
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int step = 0; step < steps; step++) {
+        batch.evolve();
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    for (int k = 0; k < batch.size(); k++) {
+        std::cout << "grid " << k << ": flashes after " << steps << " steps = " << batch.n_flashes(k)
+                  << ", first synchronized flash = " << batch.first_all_flash(k) << std::endl;
+    }
+    std::cerr << batch.size() << " grids x " << steps << " steps in " << elapsed.count() << "s: "
+              << (double)batch.size() * steps / elapsed.count() << " grid-steps/s" << std::endl;
+    return 0;
 }
 
 int main(int argc, char** argv) {
+    if (argc >= 3 && std::string(argv[1]) == "--batch") {
+        return run_batch(argv[2], argc > 3 ? std::stoi(argv[3]) : 1000);
+    }
+
+    if (argc == 4 && std::string(argv[1]) == "--steps") {
+        std::ifstream input(argv[3]);
+        OctopusGrid grid(input);
+        grid.fast_forward(std::stol(argv[2]));
+
+        std::cout << "   after " << grid.steps() << " steps: " << grid.n_flashes() << std::endl;
+        std::cout << "   all flashed on that step: " << (grid.all_flashed() ? "yes" : "no") << std::endl;
+        return 0;
+    }
+
     if (argc != 2) {
         std::cerr << "Usage: " << argv[0] << " <input_file>" << std::endl;
+        std::cerr << "       " << argv[0] << " --batch <grids_file> [steps]" << std::endl;
+        std::cerr << "       " << argv[0] << " --steps <n> <input_file>" << std::endl;
         return 1;
     }
 
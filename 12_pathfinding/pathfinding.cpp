@@ -1,9 +1,18 @@
 #include <vector>
-#include <queue>
+#include <unordered_map>
+#include <stdexcept>
+#include <cstdint>
 #include <string>
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 
 struct Cave {
     std::string name;
@@ -11,26 +20,96 @@ struct Cave {
     bool small;
 };
 
+// What a visit rule gets to see of the path so far
+struct PathState {
+    const std::vector<int>& path;
+    const std::vector<int>& visits; // times each cave is on the path
+    int small_revisits;             // repeat visits to small caves so far
+};
+
+// May a path in this state go on into cave next?  (start is never revisited regardless)
+typedef std::function<bool(const PathState& state, const int next)> VisitRule;
+
 class CaveGraph {
     public:  
+        class PathEnumerator;
         CaveGraph() {};
         bool add_vertex(const std::string& name);
         bool add_edge(const std::string& start, const std::string& end);
         std::string to_string() const;
         std::vector<std::string> get_paths(const std::string& start, const std::string& end, const int n_small_visits) const;
+        uint64_t count_paths(const std::string& start, const std::string& end, const int n_small_visits) const;
+        PathEnumerator enumerate_paths(const std::string& start, const std::string& end, const int n_small_visits) const;
+        uint64_t count_paths_parallel(const std::string& start, const std::string& end, const VisitRule& rule, int nthreads) const;
+        VisitRule small_revisit_rule(const int n_small_visits) const;
+        bool is_small(const int idx) const { return caves[idx].small; };
     private:
         std::vector<Cave> caves;
-        std::vector<std::vector<int>> adjacency_list;
+        std::unordered_map<std::string, int> cave_idx; // interned names
+        std::vector<std::vector<uint64_t>> adjacency;  // bitset of neighbours per cave
+        int next_neighbour(const int cave, const int from) const;
+        struct PathCounts {
+            int start_idx, end_idx, n_small_visits;
+            std::vector<int> small_bit;  // bit of each small cave in the visited mask, -1 if big
+            std::vector<std::unordered_map<uint64_t, uint64_t>> memo; // [cave*(n_small_visits+1) + revisits][visited]
+        };
+        uint64_t count_paths_from(PathCounts& pc, const int cave, const uint64_t visited, const int revisits) const;
+        struct PathTask {
+            std::vector<int> prefix;
+            int from; // explore neighbours of prefix.back() with index >= from
+        };
+        class PathSearchPool;
         std::string path_to_string(const std::vector<int>& path) const;
         int get_idx(const std::string& name) const;
 };
 
+// Depth-first walk over the valid paths, producing them one at a time:
+// only the current path and a per-cave visit count are kept, so memory
+// is proportional to the path depth rather than to all the paths found.
+//
+//   auto paths = graph.enumerate_paths("start", "end", 1);
+//   while (paths.next())
+//       use(paths.path());
+class CaveGraph::PathEnumerator {
+    public:
+        PathEnumerator(const CaveGraph& graph, const int start_idx, const int end_idx, const int n_small_visits);
+        bool next(); // advance to the next path; false once they are exhausted
+        const std::vector<int>& path() const { return path_stack; }; // cave indices, valid until next()
+        std::string to_string() const { return graph.path_to_string(path_stack); };
+    private:
+        const CaveGraph& graph;
+        const int start_idx, end_idx, n_small_visits;
+        std::vector<int> path_stack;
+        std::vector<int> next_edge;     // lowest neighbour index still to try at each depth
+        std::vector<int> visits;        // times each cave is on the current path
+        int revisits;
+        bool started, done;
+        void push(const int cave);
+        void pop();
+};
+
 int CaveGraph::get_idx(const std::string& name) const {
-    auto it = std::find_if(caves.begin(), caves.end(), [&name](Cave c) { return c.name == name; });
-    if (it == caves.end()) {
+    auto it = cave_idx.find(name);
+    if (it == cave_idx.end()) {
+        return -1;
+    }
+    return it->second;
+}
+
+// first neighbour of cave with index >= from, or -1; scans the bitset a word at a time
+int CaveGraph::next_neighbour(const int cave, const int from) const {
+    const auto& words = adjacency[cave];
+    size_t w = from / 64;
+    if (w >= words.size())
         return -1;
+
+    uint64_t bits = words[w] & (~0ull << (from % 64));
+    while (!bits) {
+        if (++w >= words.size())
+            return -1;
+        bits = words[w];
     }
-    return it->idx;
+    return w*64 + __builtin_ctzll(bits);
 }
 
 bool CaveGraph::add_vertex(const std::string& name) {
@@ -46,8 +125,9 @@ bool CaveGraph::add_vertex(const std::string& name) {
     }
     int idx = caves.size();
     caves.push_back({name, idx, small});
+    cave_idx[name] = idx;
 
-    adjacency_list.push_back({});
+    adjacency.push_back({});
     return true;
 }
 
@@ -58,15 +138,17 @@ bool CaveGraph::add_edge(const std::string& start, const std::string& end) {
     if ((start_idx < 0) || (end_idx < 0))
         return false;
 
-    if (std::find(adjacency_list[start_idx].begin(), adjacency_list[start_idx].end(), end_idx) != adjacency_list[start_idx].end()) {
+    auto& start_words = adjacency[start_idx];
+    if (end_idx/64 < (int)start_words.size() && (start_words[end_idx/64] & (1ull << (end_idx % 64)))) {
        return false;
     }
-    adjacency_list[start_idx].push_back(end_idx);
 
-    if (std::find(adjacency_list[end_idx].begin(), adjacency_list[end_idx].end(), start_idx) != adjacency_list[end_idx].end()) {
-       return false;
+    for (const auto& [from, to]: {std::make_pair(start_idx, end_idx), std::make_pair(end_idx, start_idx)}) {
+        auto& words = adjacency[from];
+        if (to/64 >= (int)words.size())
+            words.resize(to/64 + 1, 0);
+        words[to/64] |= 1ull << (to % 64);
     }
-    adjacency_list[end_idx].push_back(start_idx);
 
     return true;
 }
@@ -82,7 +164,7 @@ std::string CaveGraph::to_string() const {
     for (int i=0; i<caves.size(); i++) {
         std::string name = caves[i].name;
 
-        for (int j: adjacency_list[i]) {
+        for (int j = next_neighbour(i, 0); j >= 0; j = next_neighbour(i, j+1)) {
             ss << name << " -> " << caves[j].name << std::endl;
         }
     }
@@ -103,59 +185,348 @@ std::string CaveGraph::path_to_string(const std::vector<int>& path) const {
     return ss.str();
 }
 
-std::vector<std::string> CaveGraph::get_paths(const std::string& start, const std::string& end, const int n_small_visits = 0) const {
-    int start_idx = get_idx(start);
-    int end_idx = get_idx(end);
+CaveGraph::PathEnumerator::PathEnumerator(const CaveGraph& graph, const int start_idx, const int end_idx, const int n_small_visits) :
+    graph(graph), start_idx(start_idx), end_idx(end_idx), n_small_visits(n_small_visits),
+    visits(graph.caves.size(), 0), revisits(0), started(false), done(start_idx < 0 || end_idx < 0) {}
 
-    if ((start_idx < 0) || (end_idx < 0))
+void CaveGraph::PathEnumerator::push(const int cave) {
+    if (graph.caves[cave].small && visits[cave] > 0)
+        revisits++;
+    visits[cave]++;
+    path_stack.push_back(cave);
+    next_edge.push_back(0);
+}
+
+void CaveGraph::PathEnumerator::pop() {
+    const int cave = path_stack.back();
+    visits[cave]--;
+    if (graph.caves[cave].small && visits[cave] > 0)
+        revisits--;
+    path_stack.pop_back();
+    next_edge.pop_back();
+}
+
+bool CaveGraph::PathEnumerator::next() {
+    if (done)
+        return false;
+
+    if (!started) {
+        started = true;
+        push(start_idx);
+        if (start_idx == end_idx)
+            return true;
+    } else {
+        pop(); // back off the end of the last path
+    }
+
+    while (!path_stack.empty()) {
+        const int next = graph.next_neighbour(path_stack.back(), next_edge.back());
+        if (next < 0) {
+            pop();
+            continue;
+        }
+        next_edge.back() = next + 1;
+
+        if (next == start_idx) // can't visit start twice
+            continue;
+
+        const bool small_revisit = graph.caves[next].small && visits[next] > 0;
+        if (revisits + (small_revisit ? 1 : 0) > n_small_visits)
+            continue;
+
+        push(next);
+        if (next == end_idx)
+            return true;
+    }
+
+    done = true;
+    return false;
+}
+
+CaveGraph::PathEnumerator CaveGraph::enumerate_paths(const std::string& start, const std::string& end, const int n_small_visits = 0) const {
+    return PathEnumerator(*this, get_idx(start), get_idx(end), n_small_visits);
+}
+
+std::vector<std::string> CaveGraph::get_paths(const std::string& start, const std::string& end, const int n_small_visits = 0) const {
+    if ((get_idx(start) < 0) || (get_idx(end) < 0))
         return {{}};
 
-    std::vector<std::vector<int>> valid_paths;
-    std::queue<std::pair<std::vector<int>, int>> path_queue;
+    std::vector<std::string> path_representations;
+    auto paths = enumerate_paths(start, end, n_small_visits);
+    while (paths.next()) {
+        path_representations.push_back(paths.to_string());
+    }
+
+    return path_representations;
+}
+
+// Number of paths from cave onwards, given the small caves already visited
+// and the revisits used so far; that is all the future depends on, so
+// counts are memoized on it rather than enumerating paths
+uint64_t CaveGraph::count_paths_from(PathCounts& pc, const int cave, const uint64_t visited, const int revisits) const {
+    if (cave == pc.end_idx)
+        return 1;
 
-    path_queue.push(std::make_pair<std::vector<int>,int>({start_idx}, 0));
-    while (!path_queue.empty()) {
-        auto current = path_queue.front();
-        auto path = current.first;
-        auto small_revisits_so_far = current.second;
-        path_queue.pop();
+    auto& memo = pc.memo[cave*(pc.n_small_visits+1) + revisits];
+    const auto it = memo.find(visited);
+    if (it != memo.end()) {
+        if (it->second == UINT64_MAX)
+            throw std::runtime_error("infinitely many paths: two big caves are connected");
+        return it->second;
+    }
+    memo[visited] = UINT64_MAX; // in progress
 
-        auto last = path.back();
-        if (last == end_idx) {
-            valid_paths.push_back(path);
+    uint64_t count = 0;
+    for (int next = next_neighbour(cave, 0); next >= 0; next = next_neighbour(cave, next+1)) {
+        if (next == pc.start_idx) // can't visit start twice
             continue;
-        } 
 
-        for (int next: adjacency_list[last]) {
-            if (next == start_idx) // can't visit start twice
-                continue;
+        const int bit = pc.small_bit[next];
+        const bool already_visited = (bit >= 0) && (visited & (1ull << bit));
+        const int new_revisits = revisits + (already_visited ? 1 : 0);
+        if (new_revisits > pc.n_small_visits)
+            continue;
+
+        const uint64_t new_visited = (bit >= 0) ? (visited | (1ull << bit)) : visited;
+        count += count_paths_from(pc, next, new_visited, new_revisits);
+    }
+
+    pc.memo[cave*(pc.n_small_visits+1) + revisits][visited] = count;
+    return count;
+}
 
-            bool already_visited = (std::find(path.begin(), path.end(), next) != path.end());
-            bool is_small = caves[next].small;
-            int new_small_revisits = (already_visited && is_small) ? 1 : 0;
+uint64_t CaveGraph::count_paths(const std::string& start, const std::string& end, const int n_small_visits = 0) const {
+    PathCounts pc;
+    pc.start_idx = get_idx(start);
+    pc.end_idx = get_idx(end);
+    pc.n_small_visits = n_small_visits;
 
-            if (small_revisits_so_far + new_small_revisits > n_small_visits)
-                continue;
+    if ((pc.start_idx < 0) || (pc.end_idx < 0))
+        return 0;
 
-            auto new_path = path;
-            new_path.push_back(next);
-            path_queue.push(std::make_pair(new_path, small_revisits_so_far + new_small_revisits));
+    int nsmall = 0;
+    for (const auto& cave: caves) {
+        pc.small_bit.push_back(cave.small ? nsmall++ : -1);
+    }
+    if (nsmall > 64)
+        throw std::runtime_error("count_paths supports at most 64 small caves");
+
+    pc.memo.resize(caves.size() * (n_small_visits+1));
+
+    const int start_bit = pc.small_bit[pc.start_idx];
+    const uint64_t visited = (start_bit >= 0) ? (1ull << start_bit) : 0;
+    return count_paths_from(pc, pc.start_idx, visited, 0);
+}
+
+VisitRule CaveGraph::small_revisit_rule(const int n_small_visits) const {
+    return [this, n_small_visits](const PathState& state, const int next) {
+        const bool small_revisit = caves[next].small && state.visits[next] > 0;
+        return state.small_revisits + (small_revisit ? 1 : 0) <= n_small_visits;
+    };
+}
+
+// Work-stealing search for rules that can't be memoized.  Each worker owns a
+// deque of path prefixes, taking from the back and stealing from the front of
+// others'.  Search trees are very unbalanced, so rather than splitting once
+// up front, a busy worker hands off the shallowest unexplored part of its own
+// subtree whenever someone is idle.
+class CaveGraph::PathSearchPool {
+    public:
+        PathSearchPool(const CaveGraph& graph, const int start_idx, const int end_idx, const VisitRule& rule, const int nthreads);
+        uint64_t run();
+    private:
+        struct alignas(64) Worker {
+            std::mutex lock;
+            std::deque<PathTask> tasks;
+            std::atomic<int> ntasks{0}; // so the owner can check for an empty queue without locking
+            uint64_t count = 0;
+        };
+        const CaveGraph& graph;
+        const int start_idx, end_idx;
+        const VisitRule& rule;
+        std::vector<Worker> workers;
+        std::atomic<long> pending; // tasks queued or running
+        std::atomic<int> idle;
+        std::mutex idle_lock;
+        std::condition_variable work_available;
+        static const int split_interval = 256;
+        void push(const int w, PathTask&& task);
+        bool take(const int w, PathTask& task);
+        void search(const int w, const PathTask& task);
+        void work(const int w);
+};
+
+CaveGraph::PathSearchPool::PathSearchPool(const CaveGraph& graph, const int start_idx, const int end_idx, const VisitRule& rule, const int nthreads) :
+    graph(graph), start_idx(start_idx), end_idx(end_idx), rule(rule), workers(nthreads), pending(0), idle(0) {}
+
+void CaveGraph::PathSearchPool::push(const int w, PathTask&& task) {
+    pending++;
+    {
+        std::lock_guard<std::mutex> guard(workers[w].lock);
+        workers[w].tasks.push_back(std::move(task));
+        workers[w].ntasks++;
+    }
+    if (idle.load() > 0)
+        work_available.notify_one();
+}
+
+bool CaveGraph::PathSearchPool::take(const int w, PathTask& task) {
+    const int nworkers = workers.size();
+    for (int i = 0; i < nworkers; i++) {
+        Worker& victim = workers[(w + i) % nworkers];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (victim.tasks.empty())
+            continue;
+        victim.ntasks--;
+        if (i == 0) {
+            task = std::move(victim.tasks.back());
+            victim.tasks.pop_back();
+        } else {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
         }
+        return true;
     }
+    return false;
+}
 
-    // Now generate the string representation of each path
-    std::vector<std::string> path_representations;
-    for (auto path: valid_paths) {
-        path_representations.push_back(path_to_string(path));
+void CaveGraph::PathSearchPool::search(const int w, const PathTask& task) {
+    std::vector<int> path = task.prefix;
+    std::vector<int> next_edge(path.size(), graph.caves.size());
+    std::vector<int> visits(graph.caves.size(), 0);
+    int small_revisits = 0;
+    for (const int cave: path) {
+        if (graph.caves[cave].small && visits[cave] > 0)
+            small_revisits++;
+        visits[cave]++;
+    }
+    next_edge.back() = task.from;
+
+    const size_t base = path.size();
+    uint64_t count = 0;
+
+    for (long step = 1; ; step++) {
+        // someone is idle: give away the shallowest part of the tree still to explore.
+        // Only checked every so often, so handing off work stays cheap next to doing it
+        if (step % split_interval == 0 && idle.load(std::memory_order_relaxed) > 0
+                && workers[w].ntasks.load(std::memory_order_relaxed) == 0) {
+            for (size_t d = base-1; d < path.size(); d++) {
+                const int next = graph.next_neighbour(path[d], next_edge[d]);
+                if (next >= 0) {
+                    push(w, {std::vector<int>(path.begin(), path.begin() + d + 1), next});
+                    next_edge[d] = graph.caves.size();
+                    break;
+                }
+            }
+        }
+
+        const int next = graph.next_neighbour(path.back(), next_edge.back());
+        if (next < 0) {
+            if (path.size() == base)
+                break;
+            const int cave = path.back();
+            visits[cave]--;
+            if (graph.caves[cave].small && visits[cave] > 0)
+                small_revisits--;
+            path.pop_back();
+            next_edge.pop_back();
+            continue;
+        }
+        next_edge.back() = next + 1;
+
+        if (next == start_idx) // can't visit start twice
+            continue;
+        if (!rule(PathState{path, visits, small_revisits}, next))
+            continue;
+        if (next == end_idx) {
+            count++;
+            continue;
+        }
+
+        if (graph.caves[next].small && visits[next] > 0)
+            small_revisits++;
+        visits[next]++;
+        path.push_back(next);
+        next_edge.push_back(0);
     }
 
-    return path_representations;
+    workers[w].count += count;
+}
+
+void CaveGraph::PathSearchPool::work(const int w) {
+    PathTask task;
+    bool waiting = false;
+
+    while (true) {
+        if (take(w, task)) {
+            if (waiting) {
+                idle--;
+                waiting = false;
+            }
+            search(w, task);
+            if (--pending == 0)
+                work_available.notify_all();
+            continue;
+        }
+
+        if (pending.load() == 0)
+            break;
+        if (!waiting) {
+            idle++;
+            waiting = true;
+        }
+        // the timeout covers a task pushed between take() failing and the wait starting
+        std::unique_lock<std::mutex> guard(idle_lock);
+        work_available.wait_for(guard, std::chrono::milliseconds(1));
+    }
+
+    if (waiting)
+        idle--;
+}
+
+uint64_t CaveGraph::PathSearchPool::run() {
+    if (start_idx == end_idx)
+        return 1;
+
+    push(0, {{start_idx}, 0});
+
+    std::vector<std::thread> threads;
+    for (int w = 0; w < (int)workers.size(); w++) {
+        threads.emplace_back(&PathSearchPool::work, this, w);
+    }
+    for (auto& t: threads) {
+        t.join();
+    }
+
+    uint64_t count = 0;
+    for (const auto& worker: workers) {
+        count += worker.count;
+    }
+    return count;
+}
+
+uint64_t CaveGraph::count_paths_parallel(const std::string& start, const std::string& end, const VisitRule& rule, int nthreads = 0) const {
+    const int start_idx = get_idx(start);
+    const int end_idx = get_idx(end);
+
+    if ((start_idx < 0) || (end_idx < 0))
+        return 0;
+
+    if (nthreads <= 0)
+        nthreads = std::max(1u, std::thread::hardware_concurrency());
+
+    PathSearchPool pool(*this, start_idx, end_idx, rule, nthreads);
+    return pool.run();
 }
 
 int main(int argc, char const *argv[])
 {
-    if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " <input_file>" << std::endl;
+    // --paths [n_small_visits]: list the paths as they are found instead of counting them
+    // --parallel [nthreads]: count by parallel search rather than memoization
+    const bool list_paths = (argc >= 3 && std::string(argv[2]) == "--paths");
+    const bool parallel = (argc >= 3 && std::string(argv[2]) == "--parallel");
+    if (argc != 2 && !list_paths && !parallel) {
+        std::cerr << "Usage: " << argv[0] << " <input_file> [--paths [n_small_visits] | --parallel [nthreads]]" << std::endl;
         return 1;
     }
 
@@ -173,11 +544,27 @@ int main(int argc, char const *argv[])
         cave_graph.add_edge(start, end);
     }
 
-    std::vector<std::string> paths = cave_graph.get_paths("start", "end");
+    if (list_paths) {
+        auto paths = cave_graph.enumerate_paths("start", "end", argc > 3 ? std::stoi(argv[3]) : 0);
+        while (paths.next()) {
+            std::cout << paths.to_string() << std::endl;
+        }
+        return 0;
+    }
+
+    if (parallel) {
+        const int nthreads = argc > 3 ? std::stoi(argv[3]) : 0;
+        std::cout << "Part 1:" << std::endl;
+        std::cout << "      Number of paths: " << cave_graph.count_paths_parallel("start", "end", cave_graph.small_revisit_rule(0), nthreads) << std::endl;
+
+        std::cout << "Part 2:" << std::endl;
+        std::cout << "      Number of paths: " << cave_graph.count_paths_parallel("start", "end", cave_graph.small_revisit_rule(1), nthreads) << std::endl;
+        return 0;
+    }
+
     std::cout << "Part 1:" << std::endl;
-    std::cout << "      Number of paths: " << paths.size() << std::endl;
+    std::cout << "      Number of paths: " << cave_graph.count_paths("start", "end") << std::endl;
 
-    std::vector<std::string> paths_w_repeats = cave_graph.get_paths("start", "end", 1);
     std::cout << "Part 2:" << std::endl;
-    std::cout << "      Number of paths: " << paths_w_repeats.size() << std::endl;
+    std::cout << "      Number of paths: " << cave_graph.count_paths("start", "end", 1) << std::endl;
 }
\ No newline at end of file
@@ -5,9 +5,14 @@
 #include <vector>
 #include <string>
 #include <regex>
+#include <algorithm>
+#include <execution>
+#include <climits>
+#include <cstdint>
+#include <stdexcept>
 
 typedef std::pair<int, int> Point;
-typedef std::set<Point> Sheet;
+typedef std::set<Point> PointSet;
 
 enum struct FoldDir {
     X = 1,
@@ -16,7 +21,7 @@ enum struct FoldDir {
 
 typedef std::pair<FoldDir, int> Fold;
 
-std::string print_sheet(const Sheet& sheet) {
+std::string print_sheet(const PointSet& sheet) {
     int minx = INT_MAX, miny = INT_MAX, maxx = INT_MIN, maxy = INT_MIN;
     for (const auto& point : sheet) {
         if (point.first < minx) minx = point.first;
@@ -39,52 +44,195 @@ std::string print_sheet(const Sheet& sheet) {
     return ss.str();
 }
 
-void fold_sheet_y(Sheet& sheet, int yfold) {
-    Sheet new_sheet;
+// Folds along x only move x and folds along y only move y, so each axis's
+// folds compose into one table: where every coordinate ends up at the end.
+std::vector<int> compose_folds(const std::vector<Fold>& folds, const FoldDir dir, const int max_coord) {
+    std::vector<int> table(max_coord+1);
+    for (int v=0; v<=max_coord; v++) {
+        table[v] = v;
+    }
+
+    for (const auto& [fold_dir, line]: folds) {
+        if (fold_dir != dir)
+            continue;
+        for (auto& v: table) {
+            if (v > line)
+                v = 2*line - v;
+        }
+    }
+    return table;
+}
 
-    for (const auto& [x,y]: sheet) {
-        if (y > yfold) 
-            new_sheet.insert(Point(x, 2*yfold-y));
-        else
-            new_sheet.insert(Point(x, y));
+// Every dot is moved exactly once, through the composed tables, and duplicates
+// are removed once at the end rather than after every fold
+PointSet apply_folds(const std::vector<Point>& points, const std::vector<Fold>& folds) {
+    int maxx = 0, maxy = 0;
+    for (const auto& [x,y]: points) {
+        maxx = std::max(maxx, x);
+        maxy = std::max(maxy, y);
     }
 
-    sheet.swap(new_sheet);
+    const auto xtable = compose_folds(folds, FoldDir::X, maxx);
+    const auto ytable = compose_folds(folds, FoldDir::Y, maxy);
+
+    std::vector<Point> folded(points.size());
+    std::transform(std::execution::par_unseq,
+                   points.begin(), points.end(), folded.begin(),
+                   [&xtable, &ytable](const Point& p) { return Point(xtable[p.first], ytable[p.second]); });
+
+    std::sort(std::execution::par_unseq, folded.begin(), folded.end());
+    folded.erase(std::unique(folded.begin(), folded.end()), folded.end());
+
+    return PointSet(folded.begin(), folded.end());
 }
 
-void fold_sheet_x(Sheet& sheet, int xfold) {
-    Sheet new_sheet;
+// Dense alternative to a PointSet: each row is packed into 64-bit words,
+// so a fold is a handful of word-wide ORs and counting dots is a popcount.
+// Like the folding instructions, it assumes no dots lie on a fold line.
+class Sheet {
+    public:
+        Sheet(const std::vector<Point>& points, const int width, const int height);
+        void fold(const Fold& fold);
+        long count() const;
+        std::string to_string() const;
+    private:
+        int width, height, nwords;
+        std::vector<uint64_t> bits; // row-major, nwords per row, bit x%64 of word x/64
+        bool is_set(const int x, const int y) const { return bits[y*nwords + x/64] & (1ull << (x%64)); };
+        void fold_x(const int line);
+        void fold_y(const int line);
+};
 
-    for (const auto& [x,y]: sheet) {
-        if (x > xfold) 
-            new_sheet.insert(Point(2*xfold-x, y));
-        else
-            new_sheet.insert(Point(x, y));
+Sheet::Sheet(const std::vector<Point>& points, const int width, const int height) :
+    width(width), height(height), nwords((width + 63)/64), bits(height*nwords, 0) {
+    for (const auto& [x,y]: points) {
+        bits[y*nwords + x/64] |= 1ull << (x%64);
     }
+}
+
+uint64_t reverse_bits(uint64_t w) {
+    w = ((w >> 1) & 0x5555555555555555ull) | ((w & 0x5555555555555555ull) << 1);
+    w = ((w >> 2) & 0x3333333333333333ull) | ((w & 0x3333333333333333ull) << 2);
+    w = ((w >> 4) & 0x0f0f0f0f0f0f0f0full) | ((w & 0x0f0f0f0f0f0f0f0full) << 4);
+    return __builtin_bswap64(w);
+}
+
+// the 64 bits of a multi-word bitset starting at bit pos, which may run off either end
+uint64_t word_at(const std::vector<uint64_t>& words, const long pos) {
+    const long w = (pos >= 0) ? pos/64 : -((-pos + 63)/64);
+    const int b = pos - w*64;
+    auto get = [&words](const long i) { return (i >= 0 && i < (long)words.size()) ? words[i] : 0ull; };
 
-    sheet.swap(new_sheet);
+    if (b == 0)
+        return get(w);
+    return (get(w) >> b) | (get(w+1) << (64-b));
 }
 
-void apply_fold(Sheet& sheet, const Fold& fold) {
+void Sheet::fold_y(const int line) {
+    if (line >= height) // nothing lies past the fold, so nothing moves
+        return;
+    if (2*line - (height-1) < 0)
+        throw std::runtime_error("fold would move dots past the top of the sheet");
+
+    for (int y=line+1; y<height; y++) {
+        const int target = 2*line - y;
+        for (int w=0; w<nwords; w++) {
+            bits[target*nwords + w] |= bits[y*nwords + w];
+        }
+    }
+
+    height = line;
+    bits.resize(height*nwords);
+}
+
+// Reversing a whole row (word order and the bits within each word) mirrors it
+// about its far end; a shift then lines that mirror up with the fold line.
+void Sheet::fold_x(const int line) {
+    if (line >= width) // nothing lies past the fold, so nothing moves
+        return;
+    if (2*line - (width-1) < 0)
+        throw std::runtime_error("fold would move dots past the left of the sheet");
+
+    const int new_nwords = (line + 63)/64;
+    const long shift = (long)nwords*64 - 1 - 2*line;
+    std::vector<uint64_t> row(nwords), reversed(nwords);
+
+    for (int y=0; y<height; y++) {
+        std::copy(bits.begin() + y*nwords, bits.begin() + (y+1)*nwords, row.begin());
+        for (int w=0; w<nwords; w++) {
+            reversed[nwords-1-w] = reverse_bits(row[w]);
+        }
+
+        for (int w=0; w<new_nwords; w++) {
+            const int nbits = std::min(64, line - w*64);
+            const uint64_t mask = (nbits == 64) ? ~0ull : (1ull << nbits) - 1;
+            bits[y*new_nwords + w] = (row[w] | word_at(reversed, w*64 + shift)) & mask;
+        }
+    }
+
+    width = line;
+    nwords = new_nwords;
+    bits.resize(height*nwords);
+}
+
+void Sheet::fold(const Fold& fold) {
     switch (fold.first) {
         case FoldDir::X:
-            fold_sheet_x(sheet, fold.second);
+            fold_x(fold.second);
             break;
         case FoldDir::Y:
-            fold_sheet_y(sheet, fold.second);
+            fold_y(fold.second);
             break;
     }
 }
 
+long Sheet::count() const {
+    long n = 0;
+    for (const auto w: bits) {
+        n += __builtin_popcountll(w);
+    }
+    return n;
+}
+
+// rendered over the bounding box of the dots, as for a PointSet
+std::string Sheet::to_string() const {
+    int minx = INT_MAX, miny = INT_MAX, maxx = INT_MIN, maxy = INT_MIN;
+    for (int y=0; y<height; y++) {
+        for (int x=0; x<width; x++) {
+            if (is_set(x, y)) {
+                minx = std::min(minx, x);
+                maxx = std::max(maxx, x);
+                miny = std::min(miny, y);
+                maxy = std::max(maxy, y);
+            }
+        }
+    }
+
+    std::stringstream ss;
+    for (int y=miny; y<=maxy; y++) {
+        for (int x=minx; x<=maxx; x++) {
+            ss << (is_set(x, y) ? '#' : ' ');
+        }
+        ss << std::endl;
+    }
+    return ss.str();
+}
+
+std::string print_sheet(const Sheet& sheet) {
+    return sheet.to_string();
+}
+
 int main(int argc, char** argv) {
-    if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " <input_file>" << std::endl;
+    // --bitmap: fold a dense bitmap sheet instead of composing the folds over the dots
+    const bool bitmap = (argc == 3 && std::string(argv[2]) == "--bitmap");
+    if (argc != 2 && !bitmap) {
+        std::cerr << "Usage: " << argv[0] << " <input_file> [--bitmap]" << std::endl;
         return 1;
     }
 
     std::ifstream input(argv[1]);    
     std::string line;
-    Sheet s;
+    std::vector<Point> points;
     std::vector<Fold> folds;
 
     while (std::getline(input, line)) {
@@ -95,7 +243,7 @@ int main(int argc, char** argv) {
 
         if (std::regex_match(line, matches, point)) {
             auto pt = Point(std::stoi(matches[1]), std::stoi(matches[2]));
-            s.insert(pt);
+            points.push_back(pt);
         } else if (std::regex_match(line, matches, fold)) {
             auto dir = matches[1] == "x" ? FoldDir::X : FoldDir::Y;
             auto fold_size = std::stoi(matches[2]);
@@ -103,14 +251,45 @@ int main(int argc, char** argv) {
         }
     }
 
-    std::cout << "Part 1:" << std::endl;
-    apply_fold(s, folds[0]);
-    std::cout << "      Number of points = " << s.size() << std::endl;
+    if (bitmap) {
+        // the sheet extends to the first fold's mirror line, even if no dots do
+        int width = 0, height = 0;
+        for (const auto& [x,y]: points) {
+            width = std::max(width, x+1);
+            height = std::max(height, y+1);
+        }
+        for (const auto& [dir, line]: folds) {
+            if (dir == FoldDir::X) {
+                width = std::max(width, 2*line+1);
+                break;
+            }
+        }
+        for (const auto& [dir, line]: folds) {
+            if (dir == FoldDir::Y) {
+                height = std::max(height, 2*line+1);
+                break;
+            }
+        }
 
-    std::cout << "Part 2:" << std::endl;
-    for (int i=1; i<folds.size(); i++) {
-        apply_fold(s, folds[i]);
+        Sheet sheet(points, width, height);
+
+        std::cout << "Part 1:" << std::endl;
+        sheet.fold(folds[0]);
+        std::cout << "      Number of points = " << sheet.count() << std::endl;
+
+        std::cout << "Part 2:" << std::endl;
+        for (int i=1; i<folds.size(); i++) {
+            sheet.fold(folds[i]);
+        }
+        std::cout << print_sheet(sheet) << std::endl;
+        return 0;
     }
 
+    std::cout << "Part 1:" << std::endl;
+    const PointSet first_fold = apply_folds(points, {folds[0]});
+    std::cout << "      Number of points = " << first_fold.size() << std::endl;
+
+    std::cout << "Part 2:" << std::endl;
+    const PointSet s = apply_folds(points, folds);
     std::cout << print_sheet(s) << std::endl;
 }
\ No newline at end of file
@@ -4,10 +4,15 @@
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <vector>
+#include <array>
+#include <climits>
+#include <cstdint>
+#include <stdexcept>
 
 typedef char Elem;
 typedef std::pair<Elem,Elem> ElemPair;
-typedef std::map<ElemPair, long> ElemPairCounts;
+typedef unsigned __int128 Count; // exact pair counts for on the order of 100 steps
 
 void get_inputs(std::ifstream& input, std::string& initial_polymer, std::map<ElemPair, Elem>& insertion_rules) {
     std::string line;
@@ -55,91 +60,437 @@ void apply_rules(std::string& s, const std::map<ElemPair, Elem>& insertion_rules
     s = result;
 }
 
-ElemPairCounts string_to_paircounts(const std::string& input) {
-    ElemPairCounts counts;
+long score_from_element_counts(const std::map<Elem, long>& counts) {
+    long max_count = LONG_MIN, min_count=LONG_MAX;
+    for (auto [key, value] : counts) {
+        if (value > max_count) {
+            max_count = value;
+        }
+        if (value < min_count) {
+            min_count = value;
+        }
+    }
+    return max_count - min_count;
+}
 
-    for (int i=1; i<input.length(); i++) {
-        ElemPair pair(input[i-1], input[i]);
-        counts[pair]++;
+long score_polymer(const std::string& polymer) {
+    std::map<Elem, long> counts;
+    for (auto c: polymer) {
+        counts[c]++;
     }
+    return score_from_element_counts(counts);
+}
 
-    return counts;
+std::string to_string(Count c) {
+    if (c == 0)
+        return "0";
+    std::string digits;
+    while (c > 0) {
+        digits += '0' + (int)(c % 10);
+        c /= 10;
+    }
+    return std::string(digits.rbegin(), digits.rend());
 }
 
-std::string to_string(const ElemPairCounts& counts) {
-    std::stringstream ss;
+// The pairs reachable from an initial polymer, densely indexed, with the
+// rules compiled into a sparse transition: each pair becomes either the two
+// pairs its insertion creates, or itself.
+struct PairTransitions {
+    std::vector<ElemPair> pairs;             // dense index -> pair
+    std::map<ElemPair, int> pair_idx;
+    std::vector<std::array<int, 2>> targets; // pairs each pair becomes, -1 if none
+};
 
-    for (auto [key, value] : counts) {
-        ss << key.first << key.second << ": " << value << std::endl;
+PairTransitions compile_rules(const std::vector<ElemPair>& seeds, const std::map<ElemPair, Elem>& insertion_rules) {
+    PairTransitions pt;
+    auto index_of = [&pt](const ElemPair& pair) {
+        if (pt.pair_idx.find(pair) == pt.pair_idx.end()) {
+            pt.pair_idx[pair] = pt.pairs.size();
+            pt.pairs.push_back(pair);
+        }
+        return pt.pair_idx.at(pair);
+    };
+
+    for (const auto& pair: seeds) {
+        index_of(pair);
+    }
+
+    // pairs appended as they are discovered, so this walks everything reachable
+    for (int p=0; p<(int)pt.pairs.size(); p++) {
+        const ElemPair pair = pt.pairs[p];
+        const auto rule = insertion_rules.find(pair);
+        std::array<int, 2> t = {p, -1};
+        if (rule != insertion_rules.end()) {
+            t[0] = index_of(ElemPair(pair.first, rule->second));
+            t[1] = index_of(ElemPair(rule->second, pair.second));
+        }
+        pt.targets.push_back(t);
+    }
+
+    return pt;
+}
+
+PairTransitions compile_rules(const std::string& initial_polymer, const std::map<ElemPair, Elem>& insertion_rules) {
+    std::vector<ElemPair> seeds;
+    for (int i=1; i<(int)initial_polymer.length(); i++) {
+        seeds.push_back(ElemPair(initial_polymer[i-1], initial_polymer[i]));
+    }
+    return compile_rules(seeds, insertion_rules);
+}
+
+// Pair counts kept as a dense vector over the compiled pairs
+class PolymerCounter {
+    public:
+        PolymerCounter(const std::string& initial_polymer, const std::map<ElemPair, Elem>& insertion_rules);
+        void step();
+        std::map<Elem, Count> element_counts() const;
+        std::map<Elem, uint64_t> element_counts_mod(const uint64_t steps, const uint64_t modulus) const;
+        long score() const;
+    private:
+        PairTransitions transitions;
+        std::vector<Count> counts;
+        Elem last; // never changes, and is the only element not first in a pair
+};
+
+PolymerCounter::PolymerCounter(const std::string& initial_polymer, const std::map<ElemPair, Elem>& insertion_rules) :
+    transitions(compile_rules(initial_polymer, insertion_rules)), last(initial_polymer.back()) {
+    counts.assign(transitions.pairs.size(), 0);
+    for (int i=1; i<(int)initial_polymer.length(); i++) {
+        counts[transitions.pair_idx.at(ElemPair(initial_polymer[i-1], initial_polymer[i]))]++;
     }
-    return ss.str();
 }
 
+void PolymerCounter::step() {
+    std::vector<Count> result(counts.size(), 0);
+    for (int p=0; p<(int)counts.size(); p++) {
+        for (const int t: transitions.targets[p]) {
+            if (t >= 0)
+                result[t] += counts[p];
+        }
+    }
+    counts.swap(result);
+}
 
-void apply_rules(ElemPairCounts& pc, const std::map<ElemPair, Elem>& insertion_rules) {
-    ElemPairCounts result;
+std::map<Elem, Count> PolymerCounter::element_counts() const {
+    std::map<Elem, Count> elements;
+    for (int p=0; p<(int)counts.size(); p++) {
+        if (counts[p] > 0)
+            elements[transitions.pairs[p].first] += counts[p];
+    }
+    elements[last]++;
+    return elements;
+}
 
-    for (auto [key, value] : pc) {
-        if (insertion_rules.find(key) != insertion_rules.end()) {
-            Elem insertion = insertion_rules.at(key);
-            char last = key.first, next = key.second;
-            for (const ElemPair& e: {ElemPair(last, insertion), ElemPair(insertion, next)}) {
-                result[e] += value;
+long PolymerCounter::score() const {
+    std::map<Elem, long> elements;
+    for (const auto& [elem, count]: element_counts()) {
+        elements[elem] = count;
+    }
+    return score_from_element_counts(elements);
+}
+
+// Element counts after a further number of steps, modulo modulus (< 2^63),
+// by raising the transition matrix to that power: O(pairs^3 log steps)
+std::map<Elem, uint64_t> PolymerCounter::element_counts_mod(const uint64_t steps, const uint64_t modulus) const {
+    typedef std::vector<std::vector<uint64_t>> Matrix;
+    const int n = transitions.pairs.size();
+
+    // v = M^steps v, with + and * given by mul_add(acc, a, b) = acc + a*b;
+    // run once modulo modulus, and once saturating at 1 to know which pairs
+    // are present at all, since a count of 0 mod modulus need not be absent
+    auto power_apply = [n, steps](Matrix m, std::vector<uint64_t> v, auto mul_add) {
+        auto multiply = [n, &mul_add](const Matrix& a, const Matrix& b) {
+            Matrix c(n, std::vector<uint64_t>(n, 0));
+            for (int i=0; i<n; i++) {
+                for (int k=0; k<n; k++) {
+                    if (a[i][k] == 0)
+                        continue;
+                    for (int j=0; j<n; j++) {
+                        c[i][j] = mul_add(c[i][j], a[i][k], b[k][j]);
+                    }
+                }
             }
-        } else {
-            result[key] += value;
+            return c;
+        };
+
+        for (uint64_t e = steps; e > 0; e >>= 1) {
+            if (e & 1) {
+                std::vector<uint64_t> w(n, 0);
+                for (int i=0; i<n; i++) {
+                    for (int j=0; j<n; j++) {
+                        w[i] = mul_add(w[i], m[i][j], v[j]);
+                    }
+                }
+                v.swap(w);
+            }
+            if (e > 1)
+                m = multiply(m, m);
+        }
+        return v;
+    };
+
+    Matrix transition(n, std::vector<uint64_t>(n, 0));
+    for (int p=0; p<n; p++) {
+        for (const int t: transitions.targets[p]) {
+            if (t >= 0)
+                transition[t][p]++;
         }
     }
 
-    pc = result;
+    std::vector<uint64_t> start(n), present(n);
+    for (int p=0; p<n; p++) {
+        start[p] = counts[p] % modulus;
+        present[p] = (counts[p] > 0);
+    }
+
+    const auto v = power_apply(transition, start, [modulus](uint64_t acc, uint64_t a, uint64_t b) {
+        return (uint64_t)((acc + (Count)a * b) % modulus);
+    });
+    present = power_apply(transition, present, [](uint64_t acc, uint64_t a, uint64_t b) {
+        return (uint64_t)(acc || (a && b));
+    });
+
+    std::map<Elem, uint64_t> elements;
+    for (int p=0; p<n; p++) {
+        if (!present[p])
+            continue;
+        elements[transitions.pairs[p].first] = (elements[transitions.pairs[p].first] + v[p]) % modulus;
+    }
+    elements[last] = (elements[last] + 1) % modulus;
+    return elements;
 }
 
-long score_from_element_counts(const std::map<Elem, long>& counts) {
-    long max_count = LONG_MIN, min_count=LONG_MAX;
-    for (auto [key, value] : counts) {
-        if (value > max_count) {
-            max_count = value;
+// Random access into the polymer after some number of steps, without
+// building it.  For every (pair, steps) it stores how long that pair's
+// expansion is, not counting its last element (the next pair's first);
+// a query then descends the expansion tree, one level per step.
+class PolymerIndex {
+    public:
+        PolymerIndex(const std::string& initial_polymer, const std::map<ElemPair, Elem>& insertion_rules);
+        Count length(const int steps);
+        Elem char_at(Count k, const int steps);
+        std::string substring(const Count k, const Count len, const int steps);
+        template <typename Sink> void stream(Sink sink, const int steps);
+    private:
+        PairTransitions transitions;
+        std::vector<int> polymer_pairs;           // the initial polymer, as pair indices
+        std::vector<std::vector<Count>> lengths;  // [steps][pair], saturating
+        Elem last;
+        void extend_to(const int steps);
+        template <typename Sink> void expand(const int p, const int steps, Count& skip, Count& remaining, Sink& sink) const;
+};
+
+PolymerIndex::PolymerIndex(const std::string& initial_polymer, const std::map<ElemPair, Elem>& insertion_rules) :
+    transitions(compile_rules(initial_polymer, insertion_rules)), last(initial_polymer.back()) {
+    for (int i=1; i<(int)initial_polymer.length(); i++) {
+        polymer_pairs.push_back(transitions.pair_idx.at(ElemPair(initial_polymer[i-1], initial_polymer[i])));
+    }
+    lengths.push_back(std::vector<Count>(transitions.pairs.size(), 1));
+}
+
+void PolymerIndex::extend_to(const int steps) {
+    const Count max_count = ~(Count)0;
+    while ((int)lengths.size() <= steps) {
+        const auto& prev = lengths.back();
+        std::vector<Count> next(prev.size());
+        for (int p=0; p<(int)prev.size(); p++) {
+            const auto& [t0, t1] = transitions.targets[p];
+            if (t1 < 0) {
+                next[p] = prev[t0];
+            } else {
+                next[p] = (prev[t0] > max_count - prev[t1]) ? max_count : prev[t0] + prev[t1];
+            }
         }
-        if (value < min_count) {
-            min_count = value;
+        lengths.push_back(next);
+    }
+}
+
+Count PolymerIndex::length(const int steps) {
+    extend_to(steps);
+    Count total = 1; // the last element
+    for (const int p: polymer_pairs) {
+        total += lengths[steps][p];
+    }
+    return total;
+}
+
+Elem PolymerIndex::char_at(Count k, const int steps) {
+    if (k >= length(steps))
+        throw std::out_of_range("index " + to_string(k) + " is past the end of the polymer");
+    for (const int top: polymer_pairs) {
+        if (k >= lengths[steps][top]) {
+            k -= lengths[steps][top];
+            continue;
         }
+
+        int p = top;
+        for (int s = steps; s > 0 && transitions.targets[p][1] >= 0; s--) {
+            const auto& [t0, t1] = transitions.targets[p];
+            if (k < lengths[s-1][t0]) {
+                p = t0;
+            } else {
+                k -= lengths[s-1][t0];
+                p = t1;
+            }
+        }
+        return transitions.pairs[p].first;
     }
-    return max_count - min_count;
+    return last;
 }
 
-long score_polymer(const std::string& polymer) {
-    std::map<Elem, long> counts;
-    for (auto c: polymer) {
-        counts[c]++;
+// emit the part of pair p's expansion after skipping skip elements, until remaining runs out
+template <typename Sink>
+void PolymerIndex::expand(const int p, const int steps, Count& skip, Count& remaining, Sink& sink) const {
+    if (remaining == 0)
+        return;
+    if (skip >= lengths[steps][p]) {
+        skip -= lengths[steps][p];
+        return;
     }
-    return score_from_element_counts(counts);
+
+    const auto& [t0, t1] = transitions.targets[p];
+    if (steps == 0 || t1 < 0) {
+        sink(transitions.pairs[p].first);
+        remaining--;
+        return;
+    }
+    expand(t0, steps-1, skip, remaining, sink);
+    expand(t1, steps-1, skip, remaining, sink);
 }
 
-long score_paircounts(const std::string& initial_polymer, const ElemPairCounts& paircounts) {
-    std::map<Elem, long> counts;
-    for (auto [key, value] : paircounts) {
-        counts[key.first] += value;
-        counts[key.second] += value;
+std::string PolymerIndex::substring(const Count k, const Count len, const int steps) {
+    extend_to(steps);
+    std::string result;
+    Count skip = k, remaining = len;
+    auto append = [&result](const Elem c) { result += c; };
+
+    for (const int p: polymer_pairs) {
+        expand(p, steps, skip, remaining, append);
     }
+    if (remaining > 0 && skip == 0)
+        result += last;
+    return result;
+}
+
+// the whole polymer, an element at a time, without ever holding it
+template <typename Sink>
+void PolymerIndex::stream(Sink sink, const int steps) {
+    extend_to(steps);
+    Count skip = 0, remaining = ~(Count)0;
+    for (const int p: polymer_pairs) {
+        expand(p, steps, skip, remaining, sink);
+    }
+    sink(last);
+}
 
-    // Everything's double counted except the first and last character
-    // Note that by the rules of the insertions (interior to pairs),
-    // the first and last characters will never change
-    counts[initial_polymer[0]]--;
-    counts[initial_polymer[initial_polymer.length()-1]]--;
+// For scoring many polymers against one set of rules: for every (pair, steps)
+// the element counts of that pair's expansion (again without its last element)
+// are built once by DP, after which any polymer's counts at any depth are just
+// the sum over its adjacent pairs, O(length) per polymer.
+class ElementCountMemo {
+    public:
+        ElementCountMemo(const std::map<ElemPair, Elem>& insertion_rules);
+        std::map<Elem, Count> element_counts(const std::string& polymer, const int steps);
+        Count score(const std::string& polymer, const int steps);
+    private:
+        PairTransitions transitions;
+        std::string elements;                    // dense index -> element
+        std::vector<std::vector<Count>> counts;  // [steps][pair*nelems + elem]
+        void extend_to(const int steps);
+};
 
-    for (auto [key, value] : counts)
-        counts[key] = value / 2;
+// every pair over the elements in the rules, so that any polymer made of them is covered
+ElementCountMemo::ElementCountMemo(const std::map<ElemPair, Elem>& insertion_rules) {
+    for (const auto& [pair, insertion]: insertion_rules) {
+        for (const Elem e: {pair.first, pair.second, insertion}) {
+            if (elements.find(e) == std::string::npos)
+                elements += e;
+        }
+    }
 
-    counts[initial_polymer[0]]++;
-    counts[initial_polymer[initial_polymer.length()-1]]++;
+    std::vector<ElemPair> seeds;
+    for (const Elem a: elements) {
+        for (const Elem b: elements) {
+            seeds.push_back(ElemPair(a, b));
+        }
+    }
+    transitions = compile_rules(seeds, insertion_rules);
 
-    return score_from_element_counts(counts);
+    const int nelems = elements.length();
+    std::vector<Count> base(transitions.pairs.size() * nelems, 0);
+    for (int p=0; p<(int)transitions.pairs.size(); p++) {
+        base[p*nelems + elements.find(transitions.pairs[p].first)] = 1;
+    }
+    counts.push_back(base);
+}
+
+void ElementCountMemo::extend_to(const int steps) {
+    const int nelems = elements.length();
+    while ((int)counts.size() <= steps) {
+        const auto& prev = counts.back();
+        std::vector<Count> next(prev.size(), 0);
+        for (int p=0; p<(int)transitions.pairs.size(); p++) {
+            for (const int t: transitions.targets[p]) {
+                if (t < 0)
+                    continue;
+                for (int e=0; e<nelems; e++) {
+                    next[p*nelems + e] += prev[t*nelems + e];
+                }
+            }
+        }
+        counts.push_back(next);
+    }
+}
+
+std::map<Elem, Count> ElementCountMemo::element_counts(const std::string& polymer, const int steps) {
+    extend_to(steps);
+    const int nelems = elements.length();
+    std::vector<Count> totals(nelems, 0);
+    std::map<Elem, Count> result;
+
+    for (int i=1; i<(int)polymer.length(); i++) {
+        const auto it = transitions.pair_idx.find(ElemPair(polymer[i-1], polymer[i]));
+        if (it == transitions.pair_idx.end()) { // element the rules never mention: the pair never grows
+            result[polymer[i-1]]++;
+            continue;
+        }
+        const Count* pair_counts = &counts[steps][it->second * nelems];
+        for (int e=0; e<nelems; e++) {
+            totals[e] += pair_counts[e];
+        }
+    }
+    result[polymer.back()]++;
+
+    for (int e=0; e<nelems; e++) {
+        if (totals[e] > 0)
+            result[elements[e]] += totals[e];
+    }
+    return result;
+}
+
+Count ElementCountMemo::score(const std::string& polymer, const int steps) {
+    const auto counts = element_counts(polymer, steps);
+    Count max_count = 0, min_count = ~(Count)0;
+    for (const auto& [elem, count]: counts) {
+        max_count = std::max(max_count, count);
+        min_count = std::min(min_count, count);
+    }
+    return max_count - min_count;
 }
 
 int main(int argc, char** argv) {
-    if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " <input_file>" << std::endl;
+    // --steps <n> [--mod <m>]: element counts after n steps; exact up to 100 steps, otherwise modulo m
+    // --substring <k> <len> <n>: elements k..k+len-1 of the polymer after n steps
+    // --print <n>: the whole polymer after n steps
+    // --score-polymers <polymers_file> <n>: score each polymer in the file (one per line) after n steps
+    const std::string mode = (argc >= 3) ? argv[2] : "";
+    const bool steps_mode = (argc >= 4 && mode == "--steps");
+    const bool substring_mode = (argc == 6 && mode == "--substring");
+    const bool print_mode = (argc == 4 && mode == "--print");
+    const bool score_mode = (argc == 5 && mode == "--score-polymers");
+    if (argc != 2 && !steps_mode && !substring_mode && !print_mode && !score_mode) {
+        std::cerr << "Usage: " << argv[0] << " <input_file> [--steps <n> [--mod <m>] | --substring <k> <len> <n> | --print <n>"
+                  << " | --score-polymers <polymers_file> <n>]" << std::endl;
         return 1;
     }
 
@@ -148,6 +499,52 @@ int main(int argc, char** argv) {
     std::map<ElemPair, Elem> insertion_rules;
 
     get_inputs(input, initial_polymer, insertion_rules);
+
+    if (steps_mode) {
+        const uint64_t steps = std::stoull(argv[3]);
+        const uint64_t modulus = (argc >= 6 && std::string(argv[4]) == "--mod") ? std::stoull(argv[5]) : 1000000007ull;
+        PolymerCounter counter(initial_polymer, insertion_rules);
+
+        if (steps <= 100) {
+            for (uint64_t i=0; i<steps; i++) {
+                counter.step();
+            }
+            for (const auto& [elem, count]: counter.element_counts()) {
+                std::cout << elem << ": " << to_string(count) << std::endl;
+            }
+        } else {
+            for (const auto& [elem, count]: counter.element_counts_mod(steps, modulus)) {
+                std::cout << elem << ": " << count << " (mod " << modulus << ")" << std::endl;
+            }
+        }
+        return 0;
+    }
+
+    if (substring_mode) {
+        PolymerIndex index(initial_polymer, insertion_rules);
+        std::cout << index.substring(std::stoull(argv[3]), std::stoull(argv[4]), std::stoi(argv[5])) << std::endl;
+        return 0;
+    }
+
+    if (print_mode) {
+        PolymerIndex index(initial_polymer, insertion_rules);
+        index.stream([](const Elem c) { std::cout << c; }, std::stoi(argv[3]));
+        std::cout << std::endl;
+        return 0;
+    }
+
+    if (score_mode) {
+        ElementCountMemo memo(insertion_rules);
+        std::ifstream polymers(argv[3]);
+        const int steps = std::stoi(argv[4]);
+        std::string line;
+        while (std::getline(polymers, line)) {
+            if (!line.empty())
+                std::cout << line << ": " << to_string(memo.score(line, steps)) << std::endl;
+        }
+        return 0;
+    }
+
     std::string polymer = initial_polymer;
     std::cout << "Part 1:" << std::endl;
     for (int i=0; i<10; i++) {
@@ -156,11 +553,11 @@ int main(int argc, char** argv) {
     std::cout << "      Score: " << score_polymer(polymer) << std::endl;
 
     // Now, do it smarter for a larger number of iterations
-    // Rather than storing the polymer as a string, we'll store it as a set of counts of element pairs
+    // Rather than storing the polymer as a string, we'll store it as counts of element pairs
     std::cout << "Part 2:" << std::endl;
-    ElemPairCounts paircounts = string_to_paircounts(initial_polymer);
+    PolymerCounter counter(initial_polymer, insertion_rules);
     for (int i=0; i<40; i++) {
-        apply_rules(paircounts, insertion_rules);
+        counter.step();
     }
-    std::cout << "      Score: " << score_paircounts(initial_polymer, paircounts) << std::endl;
+    std::cout << "      Score: " << counter.score() << std::endl;
 }
\ No newline at end of file
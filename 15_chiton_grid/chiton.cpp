@@ -5,6 +5,17 @@
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cstdint>
+#include <stdexcept>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
 
 typedef std::vector<std::vector<short int>> Grid;
 typedef std::pair<short int, short int> Coord;
@@ -59,17 +70,6 @@ std::string to_string(const Grid& g, const std::vector<Coord>& path) {
     return ss.str();
 }
 
-std::vector<Coord> neighbours(Coord c, int n, int m) {
-    std::vector<Coord> result;
-    for (const Coord& neigh: {Coord(-1,0), Coord(0,-1), Coord(+1,0), Coord(0,+1)}) {
-        Coord new_coord = {c.first+neigh.first, c.second+neigh.second};
-        if (new_coord.first >= 0 && new_coord.first < n && new_coord.second >= 0 && new_coord.second < m) {
-            result.push_back(new_coord);
-        }
-    }
-    return result;
-}
-
 Grid embiggen_grid(const Grid& g, const int factor) {
     const int n = g.size();
     const int m = g[0].size();
@@ -88,76 +88,631 @@ Grid embiggen_grid(const Grid& g, const int factor) {
     return result;
 }
 
+// The direction each cell was reached from, packed two bits to a cell;
+// a direction is an index into the four neighbour steps of the search
+class PathTrace {
+    public:
+        PathTrace(const size_t ncells) : dirs((ncells + 3)/4, 0) {};
+        void set(const size_t c, const int dir) {
+            const int shift = 2*(c % 4);
+            dirs[c/4] = (dirs[c/4] & ~(3 << shift)) | (dir << shift);
+        };
+        int get(const size_t c) const { return (dirs[c/4] >> 2*(c % 4)) & 3; };
+    private:
+        std::vector<uint8_t> dirs;
+};
+
 // Dijkstra's algorithm, which seems overkill here?
-int find_min_path(const Grid& g, std::vector<Coord>& path) {
+// Distances are one flat array: a cell is queued the first time it gets one,
+// and a dequeued cell can never be offered a shorter one, so no other flags
+// are needed.  Predecessors are only tracked if a path is asked for.
+int find_min_path(const Grid& g, std::vector<Coord>* path = nullptr) {
     const int n=g.size();
     const int m=g[0].size();
+    const std::array<Coord, 4> steps = {Coord(-1,0), Coord(0,-1), Coord(+1,0), Coord(0,+1)};
 
-    std::vector<std::vector<Coord>> prev(n, std::vector<Coord>(m, Coord(-1,-1)));
-    std::vector<std::vector<int>> dist(n, std::vector<int>(m, INT_MAX));
-    std::vector<std::vector<bool>> queued(n, std::vector<bool>(m,false));
-    std::vector<std::vector<bool>> dequeued(n, std::vector<bool>(m,false));
+    std::vector<int32_t> dist(n*m, INT32_MAX);
+    PathTrace trace(path ? n*m : 0);
 
-    auto cmp = [&dist](Coord left, Coord right) {return dist[left.first][left.second] > dist[right.first][right.second];};
-    std::vector<Coord> coords;
+    auto cmp = [&dist](const int left, const int right) {return dist[left] > dist[right];};
+    std::vector<int> cells;
 
-    const Coord start(0,0), end(n-1,m-1);
-    coords.push_back(start);
-    dist[start.first][start.second] = 0;
+    const int start = 0, end = n*m - 1;
+    cells.push_back(start);
+    dist[start] = 0;
 
-    while (!coords.empty()) {
-        std::sort(coords.begin(), coords.end(), cmp);
-        const Coord c = coords.back(); coords.pop_back();
+    while (!cells.empty()) {
+        std::sort(cells.begin(), cells.end(), cmp);
+        const int c = cells.back(); cells.pop_back();
         if (c == end) {
             break;
         }
 
-        const int x = c.first, y = c.second;
+        const int x = c / m, y = c % m;
 
-        for (const auto& [neigh_x, neigh_y]: neighbours(c, n, m)) {
-            if (dequeued[neigh_x][neigh_y]) {
+        for (int dir = 0; dir < 4; dir++) {
+            const int neigh_x = x + steps[dir].first, neigh_y = y + steps[dir].second;
+            if (neigh_x < 0 || neigh_x >= n || neigh_y < 0 || neigh_y >= m) {
                 continue;
             }
-            auto proposed_dist = dist[x][y] + g[neigh_x][neigh_y];
-            if (proposed_dist < dist[neigh_x][neigh_y]) {
-                dist[neigh_x][neigh_y] = proposed_dist;
-                prev[neigh_x][neigh_y] = c;
-                if (!queued[neigh_x][neigh_y]) {
-                    coords.push_back(Coord(neigh_x, neigh_y));
-                    queued[neigh_x][neigh_y] = true;
+            const int neigh = neigh_x*m + neigh_y;
+            const int32_t proposed_dist = dist[c] + g[neigh_x][neigh_y];
+            if (proposed_dist < dist[neigh]) {
+                if (dist[neigh] == INT32_MAX) {
+                    cells.push_back(neigh);
+                }
+                dist[neigh] = proposed_dist;
+                if (path) {
+                    trace.set(neigh, dir);
                 }
             }
         }
-        dequeued[x][y] = true;
     }
 
     // backtrack
-    path.push_back(end);
-    while (path.back() != start) {
-        path.push_back(prev[path.back().first][path.back().second]);
+    if (path) {
+        path->push_back(Coord(n-1, m-1));
+        for (int c = end; c != start; ) {
+            c -= steps[trace.get(c)].first*m + steps[trace.get(c)].second;
+            path->push_back(Coord(c / m, c % m));
+        }
+    }
+    return dist[end];
+}
+
+// Risks stored as one flat byte array with a border of zeros around it: every
+// real cell has four neighbours at fixed offsets, and a zero risk marks the edge
+struct RiskMap {
+    int n, m;           // real rows, columns
+    int stride;         // padded row length
+    std::vector<uint8_t> cells;
+
+    int idx(int i, int j) const { return (i+1)*stride + (j+1); }
+    size_t size() const { return cells.size(); }
+    uint8_t risk(int c) const { return cells[c]; }
+    uint8_t min_risk() const;
+};
+
+uint8_t RiskMap::min_risk() const {
+    uint8_t lowest = 9;
+    for (const uint8_t r: cells) {
+        if (r != 0)
+            lowest = std::min(lowest, r);
+    }
+    return lowest;
+}
+
+RiskMap make_risk_map(const Grid& g) {
+    RiskMap map;
+    map.n = g.size();
+    map.m = g[0].size();
+    map.stride = map.m + 2;
+    map.cells.assign((map.n + 2) * map.stride, 0);
+
+    for (int i=0; i<map.n; i++) {
+        for (int j=0; j<map.m; j++) {
+            map.cells[map.idx(i, j)] = g[i][j];
+        }
+    }
+    return map;
+}
+
+// The base tile repeated factor times in each direction, each repeat one more
+// risky (wrapping 9 back to 1), computed on the fly rather than stored.
+// It is indexed like a RiskMap, with the same zero-risk border, so the
+// path engine takes either; only the distances are ever stored at full size.
+struct TiledRiskMap {
+    int n, m;
+    int stride;
+    int tile_n, tile_m;
+    std::vector<uint8_t> tile; // tile_n x tile_m, unpadded
+
+    TiledRiskMap(const Grid& g, const int factor);
+    int idx(int i, int j) const { return (i+1)*stride + (j+1); }
+    size_t size() const { return (size_t)(n + 2) * stride; }
+    uint8_t risk(int c) const {
+        const int i = c / stride - 1, j = c % stride - 1;
+        if (i < 0 || i >= n || j < 0 || j >= m)
+            return 0;
+        return (tile[(i % tile_n)*tile_m + j % tile_m] - 1 + i/tile_n + j/tile_m) % 9 + 1;
+    }
+    uint8_t min_risk() const;
+};
+
+// the repeats only ever add 0 to 2*(factor-1) to the tile, and 9 of those cover every wrap
+uint8_t TiledRiskMap::min_risk() const {
+    const int max_shift = std::min(8, n/tile_n + m/tile_m - 2);
+    uint8_t lowest = 9;
+    for (const uint8_t r: tile) {
+        for (int shift = 0; shift <= max_shift; shift++) {
+            lowest = std::min(lowest, (uint8_t)((r - 1 + shift) % 9 + 1));
+        }
+    }
+    return lowest;
+}
+
+TiledRiskMap::TiledRiskMap(const Grid& g, const int factor) : tile_n(g.size()), tile_m(g[0].size()) {
+    if ((long)tile_n * factor + 2 > INT_MAX / ((long)tile_m * factor + 2))
+        throw std::runtime_error("tiled grid too large to index");
+
+    n = tile_n * factor;
+    m = tile_m * factor;
+    stride = m + 2;
+    for (const auto& row: g) {
+        tile.insert(tile.end(), row.begin(), row.end());
+    }
+}
+
+// Priority queue for integer keys that never run more than nbuckets-1 ahead
+// of the smallest key still queued: a ring of buckets indexed by key mod nbuckets.
+// Keys must be monotone: none smaller than the last one popped.
+class BucketQueue {
+    public:
+        BucketQueue(int nbuckets) : buckets(nbuckets), current(-1), nqueued(0) {};
+        bool empty() const { return nqueued == 0; };
+        size_t size() const { return nqueued; };
+        void push(const int32_t key, const int32_t c);
+        int32_t min_key();  // the queue must not be empty
+        int32_t pop();      // a cell with the smallest key
+    private:
+        std::vector<std::vector<int32_t>> buckets;
+        int32_t current; // no key queued is smaller; -1 until the first push
+        size_t nqueued;
+};
+
+void BucketQueue::push(const int32_t key, const int32_t c) {
+    if (current < 0)
+        current = key;
+    buckets[key % buckets.size()].push_back(c);
+    nqueued++;
+}
+
+int32_t BucketQueue::min_key() {
+    while (buckets[current % buckets.size()].empty())
+        current++;
+    return current;
+}
+
+int32_t BucketQueue::pop() {
+    auto& bucket = buckets[min_key() % buckets.size()];
+    const int32_t c = bucket.back();
+    bucket.pop_back();
+    nqueued--;
+    return c;
+}
+
+// how much work a search did: cells settled, and the most queue entries
+// held at once (stale ones included)
+struct SearchStats {
+    long expanded = 0;
+    long peak_frontier = 0;
+};
+
+// Dijkstra with a circular bucket queue (Dial's algorithm).  Every edge costs
+// 1-9, so all tentative distances lie within 9 of the one being settled and
+// ten buckets indexed by distance mod 10 replace the priority queue.  Cells
+// are pushed again when improved and stale entries are skipped when popped,
+// so the work is linear in the number of cells.
+// start and end are cell indices, as given by map.idx(); the path is traced
+// only if a trace is passed.
+template <typename RiskGrid>
+int find_min_path_buckets(const RiskGrid& map, const int start, const int end, SearchStats& stats, PathTrace* trace = nullptr) {
+    BucketQueue queue(10);
+    std::vector<int32_t> dist(map.size(), INT32_MAX);
+    const std::array<int, 4> offsets = {-map.stride, -1, +1, +map.stride};
+
+    dist[start] = 0;
+    queue.push(0, start);
+
+    while (!queue.empty()) {
+        stats.peak_frontier = std::max(stats.peak_frontier, (long)queue.size());
+        const int32_t d = queue.min_key();
+        const int c = queue.pop();
+        if (dist[c] != d)
+            continue;
+        stats.expanded++;
+        if (c == end)
+            return d;
+
+        for (int dir = 0; dir < 4; dir++) {
+            const int neigh = c + offsets[dir];
+            const int risk = map.risk(neigh);
+            if (risk == 0 || d + risk >= dist[neigh])
+                continue;
+            dist[neigh] = d + risk;
+            queue.push(d + risk, neigh);
+            if (trace)
+                trace->set(neigh, dir);
+        }
+    }
+
+    return dist[end];
+}
+
+// walk a trace back from end, giving the path as coordinates from end to start
+template <typename RiskGrid>
+std::vector<Coord> traced_path(const RiskGrid& map, const PathTrace& trace, const int start, const int end) {
+    const std::array<int, 4> offsets = {-map.stride, -1, +1, +map.stride};
+    std::vector<Coord> path;
+    for (int c = end; ; c -= offsets[trace.get(c)]) {
+        path.push_back(Coord(c / map.stride - 1, c % map.stride - 1));
+        if (c == start)
+            break;
+    }
+    return path;
+}
+
+// A* ordered by distance plus min_risk times the Manhattan distance left.
+// That never overestimates, and changes by at most min_risk per step, so it
+// is consistent: keys never decrease, a cell is settled once, and a popped
+// key is at most 2*9 ahead of the smallest, which 19 buckets cover.
+template <typename RiskGrid>
+int find_min_path_astar(const RiskGrid& map, const int start, const int end, SearchStats& stats) {
+    BucketQueue queue(2*9 + 1);
+    std::vector<int32_t> dist(map.size(), INT32_MAX);
+    const std::array<int, 4> offsets = {-map.stride, -1, +1, +map.stride};
+
+    const int min_risk = map.min_risk();
+    const int end_i = end / map.stride, end_j = end % map.stride;
+    auto heuristic = [&map, min_risk, end_i, end_j](const int c) {
+        return min_risk * (std::abs(c / map.stride - end_i) + std::abs(c % map.stride - end_j));
+    };
+
+    dist[start] = 0;
+    queue.push(heuristic(start), start);
+
+    while (!queue.empty()) {
+        stats.peak_frontier = std::max(stats.peak_frontier, (long)queue.size());
+        const int32_t key = queue.min_key();
+        const int c = queue.pop();
+        if (dist[c] + heuristic(c) != key)
+            continue;
+        stats.expanded++;
+        if (c == end)
+            return dist[c];
+
+        for (const int offset: offsets) {
+            const int neigh = c + offset;
+            const int risk = map.risk(neigh);
+            if (risk == 0 || dist[c] + risk >= dist[neigh])
+                continue;
+            dist[neigh] = dist[c] + risk;
+            queue.push(dist[neigh] + heuristic(neigh), neigh);
+        }
+    }
+
+    return dist[end];
+}
+
+// Dijkstra from both ends at once, always advancing the side with the smaller
+// key.  The backward distance of a cell is the cost from it to the end, which
+// counts the risk of every cell after it, so stepping backwards from c costs
+// the risk of c.  Once the two smallest keys add up to the best meeting seen,
+// no shorter path can remain.
+template <typename RiskGrid>
+int find_min_path_bidirectional(const RiskGrid& map, const int start, const int end, SearchStats& stats) {
+    std::array<BucketQueue, 2> queues = {BucketQueue(10), BucketQueue(10)}; // forward, backward
+    std::array<std::vector<int32_t>, 2> dist;
+    const std::array<int, 4> offsets = {-map.stride, -1, +1, +map.stride};
+
+    for (auto& d: dist) {
+        d.assign(map.size(), INT32_MAX);
+    }
+    dist[0][start] = 0;
+    dist[1][end] = 0;
+    queues[0].push(0, start);
+    queues[1].push(0, end);
+    int32_t best = (start == end) ? 0 : INT32_MAX;
+
+    while (!queues[0].empty() && !queues[1].empty()) {
+        stats.peak_frontier = std::max(stats.peak_frontier, (long)(queues[0].size() + queues[1].size()));
+        if ((long)queues[0].min_key() + queues[1].min_key() >= best)
+            break;
+
+        const int side = (queues[0].min_key() <= queues[1].min_key()) ? 0 : 1;
+        auto& d = dist[side];
+        const auto& other = dist[1-side];
+
+        const int32_t key = queues[side].min_key();
+        const int c = queues[side].pop();
+        if (d[c] != key)
+            continue;
+        stats.expanded++;
+
+        for (const int offset: offsets) {
+            const int neigh = c + offset;
+            const int risk = map.risk(neigh);
+            if (risk == 0)
+                continue;
+            const int32_t proposed = d[c] + (side == 0 ? risk : map.risk(c));
+            if (proposed >= d[neigh])
+                continue;
+            d[neigh] = proposed;
+            queues[side].push(proposed, neigh);
+            if (other[neigh] != INT32_MAX)
+                best = std::min(best, proposed + other[neigh]);
+        }
+    }
+
+    return best;
+}
+
+// All threads wait here until every one of them has arrived
+class Barrier {
+    public:
+        Barrier(int nthreads) : nthreads(nthreads), waiting(0), generation(0) {};
+        void wait();
+    private:
+        std::mutex mutex;
+        std::condition_variable cv;
+        const int nthreads;
+        int waiting;
+        long generation;
+};
+
+void Barrier::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    const long arrived_in = generation;
+    if (++waiting == nthreads) {
+        waiting = 0;
+        generation++;
+        cv.notify_all();
+        return;
+    }
+    cv.wait(lock, [this, arrived_in]() { return generation != arrived_in; });
+}
+
+// lower dist to proposed if that is an improvement; true if it was
+bool atomic_relax(std::atomic<int32_t>& dist, const int32_t proposed) {
+    int32_t current = dist.load(std::memory_order_relaxed);
+    while (proposed < current) {
+        if (dist.compare_exchange_weak(current, proposed, std::memory_order_relaxed))
+            return true;
     }
-    return dist[n-1][m-1];
+    return false;
+}
+
+typedef std::vector<std::atomic<int32_t>> DistanceMap;
+
+// Delta-stepping: the distance from start to every cell (indexed like the map,
+// INT32_MAX on the border), computed by nthreads threads that each own a band
+// of rows.  Tentative distances are grouped into buckets delta wide, settled
+// one bucket at a time: edges of risk <= delta ("light") can land back in the
+// current bucket, so they are relaxed in rounds until it stays empty; heavy
+// edges cannot, and are relaxed once afterwards.  Any thread may lower any
+// distance, but only a cell's owner queues it, so an improvement across a band
+// edge is posted to the owner and picked up after the next barrier.
+
+template <typename RiskGrid>
+DistanceMap delta_stepping_distances(const RiskGrid& map, const int start, int nthreads, const int delta) {
+    typedef std::pair<int32_t, int32_t> Entry; // cell, distance it was queued at
+    nthreads = std::max(1, std::min(nthreads, map.n));
+
+    // distances lie within 9 of the bucket being settled, so a ring of buckets covers them
+    const int nbuckets = 2 + 9/delta;
+    const std::array<int, 4> offsets = {-map.stride, -1, +1, +map.stride};
+
+    DistanceMap dist(map.size());
+    std::vector<int> owner(map.n);
+    for (int t = 0; t < nthreads; t++) {
+        for (int i = map.n * t / nthreads; i < map.n * (t+1) / nthreads; i++)
+            owner[i] = t;
+    }
+
+    std::vector<std::vector<std::vector<Entry>>> buckets(nthreads, std::vector<std::vector<Entry>>(nbuckets));
+    std::vector<std::vector<std::vector<Entry>>> outbox(nthreads, std::vector<std::vector<Entry>>(nthreads)); // [from][to]
+    std::vector<long> next_bucket(nthreads);
+    std::vector<char> busy(nthreads);
+    Barrier barrier(nthreads);
+
+    auto worker = [&](const int t) {
+        const size_t begin = map.size() * t / nthreads, end = map.size() * (t+1) / nthreads;
+        for (size_t c = begin; c < end; c++)
+            dist[c].store(INT32_MAX, std::memory_order_relaxed);
+        barrier.wait();
+        if (owner[start / map.stride - 1] == t) {
+            dist[start].store(0, std::memory_order_relaxed);
+            buckets[t][0].push_back(Entry(start, 0));
+        }
+
+        auto relax_from = [&](const int c, const bool light) {
+            const int32_t d = dist[c].load(std::memory_order_relaxed);
+            for (const int offset: offsets) {
+                const int neigh = c + offset;
+                const int risk = map.risk(neigh);
+                if (risk == 0 || (risk <= delta) != light)
+                    continue;
+                if (!atomic_relax(dist[neigh], d + risk))
+                    continue;
+                const int to = owner[neigh / map.stride - 1];
+                if (to == t) // the current bucket has been taken out, so this is safe mid-round
+                    buckets[t][((d + risk) / delta) % nbuckets].push_back(Entry(neigh, d + risk));
+                else
+                    outbox[t][to].push_back(Entry(neigh, d + risk));
+            }
+        };
+        auto collect = [&]() {
+            for (int from = 0; from < nthreads; from++) {
+                for (const auto& [c, d]: outbox[from][t]) {
+                    if (dist[c].load(std::memory_order_relaxed) == d)
+                        buckets[t][(d / delta) % nbuckets].push_back(Entry(c, d));
+                }
+                outbox[from][t].clear();
+            }
+        };
+
+        std::vector<Entry> current;
+        std::vector<int32_t> settled;
+        long i = 0;
+        while (true) {
+            // the next bucket anyone has work in
+            next_bucket[t] = LONG_MAX;
+            for (long k = i; k < i + nbuckets; k++) {
+                if (!buckets[t][k % nbuckets].empty()) {
+                    next_bucket[t] = k;
+                    break;
+                }
+            }
+            barrier.wait();
+            i = *std::min_element(next_bucket.begin(), next_bucket.end());
+            if (i == LONG_MAX)
+                break;
+
+            settled.clear();
+            while (true) {
+                current.clear();
+                std::swap(current, buckets[t][i % nbuckets]);
+                for (const auto& [c, d]: current) {
+                    if (dist[c].load(std::memory_order_relaxed) != d)
+                        continue;
+                    settled.push_back(c);
+                    relax_from(c, true);
+                }
+                barrier.wait();
+                collect();
+                busy[t] = !buckets[t][i % nbuckets].empty();
+                barrier.wait();
+                if (std::find(busy.begin(), busy.end(), 1) == busy.end())
+                    break;
+            }
+
+            for (const int c: settled)
+                relax_from(c, false);
+            barrier.wait();
+            collect();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < nthreads; t++)
+        threads.emplace_back(worker, t);
+    for (auto& th: threads)
+        th.join();
+
+    return dist;
+}
+
+// run every engine on one query and report what each of them cost
+template <typename RiskGrid>
+void compare_engines(const RiskGrid& map, const int start, const int end) {
+    typedef int (*Engine)(const RiskGrid&, const int, const int, SearchStats&);
+    const std::vector<std::pair<std::string, Engine>> engines = {
+        {"dijkstra", [](const RiskGrid& map, const int start, const int end, SearchStats& stats) {
+            return find_min_path_buckets(map, start, end, stats);
+        }},
+        {"astar", find_min_path_astar<RiskGrid>},
+        {"bidirectional", find_min_path_bidirectional<RiskGrid>},
+    };
+
+    for (const auto& [name, engine]: engines) {
+        SearchStats stats;
+        const auto t0 = std::chrono::steady_clock::now();
+        const int cost = engine(map, start, end, stats);
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - t0;
+        std::cout << "      " << name << ": min cost path = " << cost << ", expanded " << stats.expanded
+                  << ", peak frontier " << stats.peak_frontier << ", " << elapsed.count() << "s" << std::endl;
+    }
+}
+
+template <typename RiskGrid>
+int corner_to_corner(const RiskGrid& map, std::vector<Coord>* path = nullptr) {
+    SearchStats stats;
+    const int start = map.idx(0, 0), end = map.idx(map.n-1, map.m-1);
+    if (!path)
+        return find_min_path_buckets(map, start, end, stats);
+
+    PathTrace trace(map.size());
+    const int cost = find_min_path_buckets(map, start, end, stats, &trace);
+    *path = traced_path(map, trace, start, end);
+    return cost;
 }
 
 int main(int argc, char** argv) {
-    if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " <input_file>" << std::endl;
+    // --sorted: the original Dijkstra, re-sorting the whole frontier every iteration
+    // --show-path: draw the path found for part 1
+    // --factor <k>: tile the grid k times each way for part 2 instead of 5
+    // --parallel [nthreads]: solve the parts with parallel delta-stepping, which also maps
+    //     the distance to every cell
+    // --delta <d>: bucket width for --parallel; risks above it are relaxed as heavy edges
+    // --query <row0> <col0> <row1> <col1>: instead of the parts, compare every engine on
+    //     the path between two cells, in the grid tiled by --factor if given
+    bool sorted = false, show_path = false, query = false, tiled = false, parallel = false, usage = (argc < 2);
+    int factor = 5, delta = 9;
+    int nthreads = std::max(1u, std::thread::hardware_concurrency());
+    std::array<int, 4> query_cells;
+    for (int i = 2; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--sorted") {
+            sorted = true;
+        } else if (arg == "--show-path") {
+            show_path = true;
+        } else if (arg == "--factor" && i+1 < argc) {
+            factor = std::stoi(argv[++i]);
+            tiled = true;
+        } else if (arg == "--parallel") {
+            parallel = true;
+            if (i+1 < argc && isdigit(argv[i+1][0]))
+                nthreads = std::stoi(argv[++i]);
+        } else if (arg == "--delta" && i+1 < argc) {
+            delta = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--query" && i+4 < argc) {
+            query = true;
+            for (auto& v: query_cells)
+                v = std::stoi(argv[++i]);
+        } else {
+            usage = true;
+        }
+    }
+    if (usage) {
+        std::cerr << "Usage: " << argv[0] << " <input_file> [--sorted | --parallel [nthreads] [--delta <d>]] [--show-path] [--factor <k>] [--query <row0> <col0> <row1> <col1>]" << std::endl;
         return 1;
     }
 
     std::ifstream input(argv[1]);    
     const Grid grid = get_inputs(input);
 
-    std::vector<Coord> path;
-    const int min_path = find_min_path(grid, path);
+    if (query) {
+        const TiledRiskMap map(grid, tiled ? factor : 1);
+        const auto [i0, j0, i1, j1] = query_cells;
+        for (const auto& [i, j]: {std::make_pair(i0, j0), std::make_pair(i1, j1)}) {
+            if (i < 0 || i >= map.n || j < 0 || j >= map.m) {
+                std::cerr << "query cell " << i << "," << j << " is outside the " << map.n << "x" << map.m << " grid" << std::endl;
+                return 1;
+            }
+        }
+        std::cout << "Query:" << std::endl;
+        compare_engines(map, map.idx(i0, j0), map.idx(i1, j1));
+        return 0;
+    }
+
+    if (parallel) {
+        auto solve = [nthreads, delta](const auto& map) {
+            const auto dist = delta_stepping_distances(map, map.idx(0, 0), nthreads, delta);
+            int32_t farthest = 0;
+            for (const auto& d: dist) {
+                if (d != INT32_MAX)
+                    farthest = std::max(farthest, d.load());
+            }
+            std::cout << "      Min cost path = " << dist[map.idx(map.n-1, map.m-1)]
+                      << " (costliest cell to reach = " << farthest << ")" << std::endl;
+        };
+        std::cout << "Part 1:" << std::endl;
+        solve(make_risk_map(grid));
+        std::cout << "Part 2:" << std::endl;
+        solve(TiledRiskMap(grid, factor));
+        return 0;
+    }
 
+    std::vector<Coord> path;
+    std::vector<Coord>* wanted_path = show_path ? &path : nullptr;
     std::cout << "Part 1:" << std::endl;
+    const int min_path = sorted ? find_min_path(grid, wanted_path) : corner_to_corner(make_risk_map(grid), wanted_path);
     std::cout << "      Min cost path = " << min_path << std::endl;
+    if (show_path)
+        std::cout << to_string(grid, path);
 
     std::cout << "Part 2:" << std::endl;
-    Grid big_grid = embiggen_grid(grid, 5);
-
-    path.clear();
-    const int min_big_path = find_min_path(big_grid, path);
+    const int min_big_path = sorted ? find_min_path(embiggen_grid(grid, factor))
+                                    : corner_to_corner(TiledRiskMap(grid, factor));
     std::cout << "      Min cost path = " << min_big_path << std::endl;
-}
\ No newline at end of file
+}
@@ -3,106 +3,123 @@
 #include <sstream>
 #include <string>
 #include <vector>
-#include <map>
 #include <numeric>
+#include <algorithm>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 const int bits_per_char = 4;  // hex representation
-const std::map<char, short int> hex_lookup = 
-    {{'0', 0}, {'1', 1}, {'2', 2}, {'3', 3}, {'4', 4}, {'5', 5}, {'6', 6}, {'7', 7},
-     {'8', 8}, {'9', 9}, {'A', 10}, {'B', 11}, {'C', 12}, {'D', 13}, {'E', 14}, {'F', 15}};
 
-char byte_to_char(short int byte, const short int nbits) {
-    if (nbits < bits_per_char) {
-        byte <<= (bits_per_char - nbits);
-    }
-    return (byte < 10) ? '0' + byte : 'A' + byte - 10;
+int hex_digit(const char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    throw std::invalid_argument(std::string("invalid hex digit '") + c + "'");
 }
 
-typedef struct bitstream_cursor {
-    int char_idx;
-    int bit_idx;
-    bitstream_cursor(int char_idx=0, int bit_idx=bits_per_char-1) : char_idx(char_idx), bit_idx(bit_idx) {}
-} bitstream_cursor_t;
-
+// The hex input is decoded once into bytes, padded with 8 zero bytes so that a
+// 64-bit load from any position stays in bounds; bits are then read a whole
+// big-endian word at a time.  A sub-stream is just another window (position,
+// limit) onto the same bytes, so nothing is copied or re-encoded.
+// Raw bytes can be taken as they are, with no hex at all.
 class Bitstream {
     public:
-        Bitstream(const std::string& hex_input, const int nbits);
+        Bitstream(std::string_view hex_input);
+        Bitstream(const uint8_t* raw, const size_t nbytes);
         unsigned long int next_n_bits_as_int(const int n_bits);
         Bitstream next_n_bits_as_bitstream(const int n_bits);
-        bool bits_left() const;
+        bool bits_left() const { return position < limit; };
+        long bit_position() const { return position; };
         std::string to_string() const;
     private:
-        const std::string hex_input;
-        bitstream_cursor_t cursor;
-        std::vector<bool> next_n_bits(const int n_bits);
-        short int byte_at(const int idx) const;
-        int _nbits;
+        Bitstream(const std::shared_ptr<const std::vector<uint8_t>>& bytes, const long position, const long limit) :
+            bytes(bytes), position(position), limit(limit) {};
+        std::shared_ptr<const std::vector<uint8_t>> bytes;
+        long position;  // in bits
+        long limit;     // bits past it read as zero
+        static const int max_window_bits = 57; // a 64-bit load less the up-to-7-bit offset into its first byte
 };
 
-Bitstream::Bitstream(const std::string& hex_input, const int nbits=-1) : hex_input(hex_input), cursor() {
-    if (nbits == -1) {
-        _nbits = hex_input.length() * bits_per_char;
-    } else {
-        _nbits = nbits;
+Bitstream::Bitstream(std::string_view hex_input) : position(0), limit(hex_input.length() * bits_per_char) {
+    std::vector<uint8_t> decoded((hex_input.length() + 1)/2 + sizeof(uint64_t), 0);
+    for (size_t i = 0; i < hex_input.length(); i++) {
+        decoded[i/2] |= hex_digit(hex_input[i]) << ((i % 2) ? 0 : bits_per_char);
     }
+    bytes = std::make_shared<const std::vector<uint8_t>>(std::move(decoded));
 }
 
-bool Bitstream::bits_left() const {
-    auto bit_posn = cursor.char_idx * bits_per_char + ((bits_per_char-1) - cursor.bit_idx);
-    return bit_posn < _nbits;
+Bitstream::Bitstream(const uint8_t* raw, const size_t nbytes) : position(0), limit(nbytes * 8) {
+    std::vector<uint8_t> padded(nbytes + sizeof(uint64_t), 0);
+    std::copy(raw, raw + nbytes, padded.begin());
+    bytes = std::make_shared<const std::vector<uint8_t>>(std::move(padded));
 }
 
 std::string Bitstream::to_string() const {
     std::stringstream ss;
-    auto bit_posn = cursor.char_idx * bits_per_char + ((bits_per_char-1) - cursor.bit_idx);
-    ss << "\"" << hex_input << "\"" << "  " << _nbits << " bits, cur_position = " << cursor.char_idx << ":" << cursor.bit_idx << " (" << bit_posn << ")" << std::endl;
+    ss << "\"" << std::hex << std::uppercase;
+    for (long byte = position/8; byte < (limit + 7)/8; byte++) {
+        ss << ((*bytes)[byte] >> 4) << ((*bytes)[byte] & 0xF);
+    }
+    ss << std::dec << "\"  bits " << position << " to " << limit << std::endl;
     return ss.str();
 }
 
-short int Bitstream::byte_at(const int idx) const {
-    if (idx < 0 || idx >= hex_input.length()) {
-        return 0;
+unsigned long int Bitstream::next_n_bits_as_int(const int n_bits) {
+    if (n_bits > max_window_bits) {
+        const unsigned long int high = next_n_bits_as_int(n_bits - 32);
+        return (high << 32) | next_n_bits_as_int(32);
+    }
+    if (n_bits <= 0)
+        return 0ul;
+
+    // only reads past the end of the input can start in the padding
+    uint64_t window = 0;
+    if (position/8 + (long)sizeof(window) <= (long)bytes->size()) {
+        std::memcpy(&window, bytes->data() + position/8, sizeof(window));
+        window = __builtin_bswap64(window);
     }
-    return hex_lookup.at(hex_input[idx]);
-}
 
-unsigned long int Bitstream::next_n_bits_as_int(const int n_bits) {
-    unsigned long int result = 0ul;
-    int nbits_remaining = n_bits;
-    short int cur_char = byte_at(cursor.char_idx);
-
-    while (nbits_remaining > 0) {
-        result <<= 1;
-        result += (cur_char & 1<<(cursor.bit_idx)) ? 1 : 0;
-
-        nbits_remaining--;
-        cursor.bit_idx--;
-        if (cursor.bit_idx < 0) {
-            cursor.bit_idx = bits_per_char-1;
-            cursor.char_idx++;
-            cur_char = byte_at(cursor.char_idx);
-        }
+    unsigned long int result = (window << (position % 8)) >> (64 - n_bits);
+    if (position + n_bits > limit) {
+        const long past_limit = std::min((long)n_bits, position + n_bits - limit);
+        result = (past_limit == 64) ? 0 : (result >> past_limit) << past_limit;
     }
 
+    position += n_bits;
     return result;
 }
 
 Bitstream Bitstream::next_n_bits_as_bitstream(const int n_bits) {
-    std::string new_input;
-    int nbits_remaining = n_bits;
+    Bitstream substream(bytes, position, std::min(position + n_bits, limit));
+    position += n_bits;
+    return substream;
+}
 
-    while (nbits_remaining > 0) {
-        auto nbits_taken = (nbits_remaining >= 4) ? 4 : nbits_remaining;
-        short int byte = (short int)(next_n_bits_as_int(nbits_taken) & 0xF);
 
-        new_input += byte_to_char(byte, nbits_taken);
-        nbits_remaining -= nbits_taken;
-    }
+unsigned long int decode_literal(Bitstream& bitstream) {
+    bool keep_reading = true;
+    unsigned long int result = 0;
 
-    return Bitstream(new_input, n_bits);
+    while (keep_reading) {
+        unsigned long int data = bitstream.next_n_bits_as_int(bits_per_char+1);
+        result <<= bits_per_char;
+        result += data & (0xF);
+        if (!(data & 0x10)) 
+            keep_reading = false;
+    }
+    return result;
 }
 
-
 class Packet {
     public:
         Packet(Bitstream& bitstream);
@@ -126,7 +143,6 @@ class Packet {
         unsigned long int _literal_value;
         std::vector<Packet> subpackets;
 
-        unsigned long int decode_literal(Bitstream& bitstream);
         void decode(Bitstream& bitstream);
 };
 
@@ -182,20 +198,6 @@ std::string Packet::to_string(const std::string& prefix="") const {
     return ss.str();
 }
 
-unsigned long int Packet::decode_literal(Bitstream& bitstream) {
-    bool keep_reading = true;
-    unsigned long int result = 0;
-
-    while (keep_reading) {
-        unsigned long int data = bitstream.next_n_bits_as_int(bits_per_char+1);
-        result <<= bits_per_char;
-        result += data & (0xF);
-        if (!(data & 0x10)) 
-            keep_reading = false;
-    }
-    return result;
-}
-
 Packet::Packet(Bitstream& bitstream) {
     _version = bitstream.next_n_bits_as_int(3);
     _type = bitstream.next_n_bits_as_int(3);
@@ -224,9 +226,397 @@ Packet::Packet(Bitstream& bitstream) {
     }
 }
 
+// Version sum and value of a transmission in one pass over its bits, without
+// building any packets.  Each operator still waiting on subpackets has a frame
+// on an explicit stack holding its running result, so memory grows only with
+// the nesting depth and deep transmissions cannot overflow the call stack.
+struct Evaluation {
+    long int version_sum;
+    long int value;
+};
+
+struct OperatorFrame {
+    int type;
+    long end_bit;       // subpackets end at this bit position, or
+    long remaining;     // this many subpackets are still to come (-1 if bounded by end_bit)
+    long int result;
+    long nvalues;
+
+    void add(const long int value);
+    bool done(const Bitstream& bitstream) const {
+        return (remaining >= 0) ? remaining == 0 : bitstream.bit_position() >= end_bit;
+    };
+};
+
+// the comparisons keep their first operand in result until the second arrives
+void OperatorFrame::add(const long int value) {
+    if (remaining > 0)
+        remaining--;
+
+    switch (type) {
+        case Packet::SUM:
+            result += value;
+            break;
+        case Packet::PRODUCT:
+            result *= value;
+            break;
+        case Packet::MINIMUM:
+            result = (nvalues == 0) ? value : std::min(result, value);
+            break;
+        case Packet::MAXIMUM:
+            result = (nvalues == 0) ? value : std::max(result, value);
+            break;
+        case Packet::GREATER_THAN:
+            result = (nvalues == 0) ? value : (result > value) ? 1l : 0l;
+            break;
+        case Packet::LESS_THAN:
+            result = (nvalues == 0) ? value : (result < value) ? 1l : 0l;
+            break;
+        case Packet::EQUAL:
+            result = (nvalues == 0) ? value : (result == value) ? 1l : 0l;
+            break;
+    }
+    nvalues++;
+}
+
+Evaluation evaluate_stream(Bitstream& bitstream) {
+    std::vector<OperatorFrame> stack;
+    long int version_sum = 0;
+
+    while (true) {
+        version_sum += bitstream.next_n_bits_as_int(3);
+        const int type = bitstream.next_n_bits_as_int(3);
+
+        long int value;
+        if (type == Packet::LITERAL) {
+            value = decode_literal(bitstream);
+        } else {
+            OperatorFrame frame = {type, 0, -1, (type == Packet::PRODUCT) ? 1l : 0l, 0};
+            if (bitstream.next_n_bits_as_int(1) == 0) {
+                const long nbits = bitstream.next_n_bits_as_int(15);
+                frame.end_bit = bitstream.bit_position() + nbits;
+            } else {
+                frame.remaining = bitstream.next_n_bits_as_int(11);
+            }
+
+            stack.push_back(frame);
+            if (!stack.back().done(bitstream))
+                continue;
+            value = stack.back().result; // an operator with no subpackets
+            stack.pop_back();
+        }
+
+        // hand the value up, closing every operator it completes
+        while (true) {
+            if (stack.empty())
+                return {version_sum, value};
+            stack.back().add(value);
+            if (!stack.back().done(bitstream))
+                break;
+            value = stack.back().result;
+            stack.pop_back();
+        }
+    }
+}
+
+// The packet tree kept flat for repeated queries: nodes are numbered in
+// preorder and each field is its own array, so a node's subtree is the
+// contiguous range [node, subtree_end) and every child comes after its parent.
+// A node's children are listed at children[child_begin .. child_begin+child_count).
+class PacketArena {
+    public:
+        PacketArena(Bitstream& bitstream);
+        size_t size() const { return types.size(); };
+        size_t subtree_size(const size_t node) const { return subtree_end[node] - node; };
+        size_t child(const size_t node, const size_t k) const { return children[child_begin[node] + k]; };
+        size_t n_children(const size_t node) const { return child_count[node]; };
+        int type(const size_t node) const { return types[node]; };
+        long int version_sum(const size_t node=0) const;
+        long int value(const size_t node=0) const;
+    private:
+        std::vector<uint8_t> versions;
+        std::vector<uint8_t> types;
+        std::vector<uint64_t> literals;
+        std::vector<uint32_t> child_begin;
+        std::vector<uint32_t> child_count;
+        std::vector<uint32_t> subtree_end;
+        std::vector<uint32_t> children;
+};
+
+// parsed without recursion, like evaluate_stream: each open operator is a frame
+// that closes once its bits or its subpacket count run out
+PacketArena::PacketArena(Bitstream& bitstream) {
+    struct OpenNode {
+        uint32_t node;
+        long end_bit;
+        long remaining;
+    };
+    std::vector<OpenNode> stack;
+    std::vector<uint32_t> parents;
+
+    do {
+        const uint32_t node = types.size();
+        parents.push_back(stack.empty() ? node : stack.back().node);
+        versions.push_back(bitstream.next_n_bits_as_int(3));
+        types.push_back(bitstream.next_n_bits_as_int(3));
+        literals.push_back(0);
+        subtree_end.push_back(0);
+
+        if (types.back() == Packet::LITERAL) {
+            literals.back() = decode_literal(bitstream);
+            subtree_end[node] = node + 1;
+        } else {
+            OpenNode open = {node, 0, -1};
+            if (bitstream.next_n_bits_as_int(1) == 0) {
+                const long nbits = bitstream.next_n_bits_as_int(15);
+                open.end_bit = bitstream.bit_position() + nbits;
+            } else {
+                open.remaining = bitstream.next_n_bits_as_int(11);
+            }
+            stack.push_back(open);
+        }
+
+        // close every operator that now has all of its subpackets
+        bool completed = (types.back() == Packet::LITERAL);
+        while (!stack.empty()) {
+            auto& open = stack.back();
+            if (completed && open.remaining > 0)
+                open.remaining--;
+            const bool done = (open.remaining >= 0) ? open.remaining == 0 : bitstream.bit_position() >= open.end_bit;
+            if (!done)
+                break;
+            subtree_end[open.node] = types.size();
+            stack.pop_back();
+            completed = true;
+        }
+    } while (!stack.empty());
+
+    // children listed parent by parent; within a parent, preorder keeps them in order
+    const size_t n = types.size();
+    child_count.assign(n, 0);
+    for (size_t node = 1; node < n; node++) {
+        child_count[parents[node]]++;
+    }
+    child_begin.assign(n, 0);
+    for (size_t node = 1; node < n; node++) {
+        child_begin[node] = child_begin[node-1] + child_count[node-1];
+    }
+
+    std::vector<uint32_t> next_slot = child_begin;
+    children.resize(n - 1);
+    for (size_t node = 1; node < n; node++) {
+        children[next_slot[parents[node]]++] = node;
+    }
+}
+
+long int PacketArena::version_sum(const size_t node) const {
+    long int sum = 0;
+    for (size_t i = node; i < subtree_end[node]; i++) {
+        sum += versions[i];
+    }
+    return sum;
+}
+
+// post-order without recursion: walking the subtree backwards reaches every
+// child before its parent
+long int PacketArena::value(const size_t node) const {
+    std::vector<long int> values(subtree_end[node] - node);
+
+    for (size_t i = subtree_end[node]; i-- > node; ) {
+        if (types[i] == Packet::LITERAL) {
+            values[i - node] = literals[i];
+            continue;
+        }
+
+        OperatorFrame frame = {types[i], 0, -1, (types[i] == Packet::PRODUCT) ? 1l : 0l, 0};
+        for (uint32_t k = child_begin[i]; k < child_begin[i] + child_count[i]; k++) {
+            frame.add(values[children[k] - node]);
+        }
+        values[i - node] = frame.result;
+    }
+
+    return values[0];
+}
+
+// A whole file mapped read-only into memory
+class MappedFile {
+    public:
+        MappedFile(const char* filename);
+        ~MappedFile();
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        const uint8_t* data() const { return bytes; };
+        size_t size() const { return nbytes; };
+    private:
+        const uint8_t* bytes;
+        size_t nbytes;
+};
+
+MappedFile::MappedFile(const char* filename) : bytes(nullptr), nbytes(0) {
+    const int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error(std::string("cannot open ") + filename);
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        throw std::runtime_error(std::string("cannot stat ") + filename);
+    }
+    nbytes = info.st_size;
+
+    if (nbytes > 0) {
+        void* mapped = mmap(nullptr, nbytes, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error(std::string("cannot map ") + filename);
+        }
+        bytes = static_cast<const uint8_t*>(mapped);
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (bytes)
+        munmap(const_cast<uint8_t*>(bytes), nbytes);
+}
+
+// Many transmissions in one file, either one hex line each or in raw binary
+// framing: a 4-byte little-endian byte count, then that many bytes.
+struct Transmission {
+    size_t offset;
+    size_t length;
+};
+
+std::vector<Transmission> index_hex_lines(const MappedFile& file) {
+    std::vector<Transmission> transmissions;
+    const char* text = reinterpret_cast<const char*>(file.data());
+    size_t begin = 0;
+    while (begin < file.size()) {
+        const void* newline = std::memchr(text + begin, '\n', file.size() - begin);
+        size_t end = newline ? static_cast<const char*>(newline) - text : file.size();
+        const size_t next = end + 1;
+        if (end > begin && text[end-1] == '\r')
+            end--;
+        if (end > begin)
+            transmissions.push_back({begin, end - begin});
+        begin = next;
+    }
+    return transmissions;
+}
+
+std::vector<Transmission> index_binary_frames(const MappedFile& file) {
+    std::vector<Transmission> transmissions;
+    size_t pos = 0;
+    while (pos < file.size()) {
+        if (pos + 4 > file.size())
+            throw std::runtime_error("truncated frame header");
+        const uint8_t* header = file.data() + pos;
+        const size_t length = header[0] | header[1] << 8 | header[2] << 16 | (size_t)header[3] << 24;
+        if (pos + 4 + length > file.size())
+            throw std::runtime_error("truncated frame");
+        transmissions.push_back({pos + 4, length});
+        pos += 4 + length;
+    }
+    return transmissions;
+}
+
+// Transmissions are handed out to the threads a block at a time, so a few
+// long ones cannot leave the others idle; each is evaluated in one pass.
+// Prints one "version_sum value" line per transmission, in input order, or an
+// "error: ..." line for one that could not be decoded.
+int run_batch(const char* filename, const bool binary, int nthreads) {
+    const MappedFile file(filename);
+    const auto transmissions = binary ? index_binary_frames(file) : index_hex_lines(file);
+    std::vector<Evaluation> results(transmissions.size());
+    std::vector<std::string> errors(transmissions.size()); // empty unless that one failed to decode
+
+    const size_t block = 64;
+    std::atomic<size_t> next_block(0);
+    nthreads = std::max(1, nthreads);
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < nthreads; t++) {
+        threads.emplace_back([&]() {
+            for (size_t first = next_block.fetch_add(block); first < transmissions.size(); first = next_block.fetch_add(block)) {
+                for (size_t k = first; k < std::min(first + block, transmissions.size()); k++) {
+                    const auto& [offset, length] = transmissions[k];
+                    try {
+                        Bitstream bitstream = binary ? Bitstream(file.data() + offset, length)
+                            : Bitstream(std::string_view(reinterpret_cast<const char*>(file.data()) + offset, length));
+                        results[k] = evaluate_stream(bitstream);
+                    } catch (const std::exception& e) {
+                        errors[k] = e.what();
+                    }
+                }
+            }
+        });
+    }
+    for (auto& th: threads)
+        th.join();
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::string output;
+    long nerrors = 0;
+    for (size_t k = 0; k < results.size(); k++) {
+        if (!errors[k].empty()) {
+            output += "error: " + errors[k] + '\n';
+            nerrors++;
+            continue;
+        }
+        output += std::to_string(results[k].version_sum) + ' ' + std::to_string(results[k].value) + '\n';
+    }
+    std::cout << output;
+    if (nerrors > 0)
+        std::cerr << nerrors << " transmissions could not be decoded" << std::endl;
+
+    std::cerr << transmissions.size() << " transmissions, " << file.size() / 1e6 << " MB in " << elapsed.count() << "s: "
+              << file.size() / 1e6 / elapsed.count() << " MB/s with " << nthreads << " threads" << std::endl;
+    return 0;
+}
+
+// rewrite a file of hex lines in the binary framing
+int pack_binary(const char* hex_filename, const char* binary_filename) {
+    std::ifstream input(hex_filename);
+    std::ofstream output(binary_filename, std::ios::binary);
+    std::string line;
+    while (std::getline(input, line)) {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (line.empty())
+            continue;
+        if (line.length() % 2)
+            line += '0';
+
+        std::string frame(4 + line.length()/2, 0);
+        const uint32_t length = line.length()/2;
+        for (int b = 0; b < 4; b++)
+            frame[b] = (length >> 8*b) & 0xFF;
+        for (size_t i = 0; i < line.length(); i += 2)
+            frame[4 + i/2] = hex_digit(line[i]) << bits_per_char | hex_digit(line[i+1]);
+        output << frame;
+    }
+    return 0;
+}
+
 int main(int argc, char** argv) {
-    if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " <input_file>" << std::endl;
+    const int default_threads = std::max(1u, std::thread::hardware_concurrency());
+    if (argc >= 3 && (std::string(argv[1]) == "--batch" || std::string(argv[1]) == "--batch-binary")) {
+        return run_batch(argv[2], std::string(argv[1]) == "--batch-binary", argc > 3 ? std::stoi(argv[3]) : default_threads);
+    }
+    if (argc == 4 && std::string(argv[1]) == "--pack") {
+        return pack_binary(argv[2], argv[3]);
+    }
+
+    // --streaming: evaluate in a single pass over the bits, without building the packet tree
+    // --arena: build the tree flat, in preorder arrays
+    const bool streaming = (argc == 3 && std::string(argv[2]) == "--streaming");
+    const bool arena = (argc == 3 && std::string(argv[2]) == "--arena");
+    if (argc != 2 && !streaming && !arena) {
+        std::cerr << "Usage: " << argv[0] << " <input_file> [--streaming | --arena]" << std::endl;
+        std::cerr << "       " << argv[0] << " --batch <hex_lines_file> [nthreads]" << std::endl;
+        std::cerr << "       " << argv[0] << " --batch-binary <framed_file> [nthreads]" << std::endl;
+        std::cerr << "       " << argv[0] << " --pack <hex_lines_file> <framed_file>" << std::endl;
         return 1;
     }
     std::ifstream input_file(argv[1]);
@@ -235,6 +625,29 @@ int main(int argc, char** argv) {
     std::getline(input_file, input_string);
 
     Bitstream bitstream(input_string);
+    if (streaming) {
+        const auto result = evaluate_stream(bitstream);
+
+        std::cout << "Part 1:" << std::endl;
+        std::cout << "     Version sum: " << result.version_sum << std::endl;
+
+        std::cout << "Part 2:" << std::endl;
+        std::cout << "     Value: " << result.value << std::endl;
+        return 0;
+    }
+
+    if (arena) {
+        const PacketArena packets(bitstream);
+
+        std::cout << "Part 1:" << std::endl;
+        std::cout << "     Version sum: " << packets.version_sum() << std::endl;
+
+        std::cout << "Part 2:" << std::endl;
+        std::cout << "     Value: " << packets.value() << std::endl;
+        std::cout << "     (" << packets.size() << " packets)" << std::endl;
+        return 0;
+    }
+
     Packet packet(bitstream);
 
     std::cout << "Part 1:" << std::endl;